@@ -1,22 +1,53 @@
 #include "BuildSystem.hpp"
+#include "Workspace.hpp"
 #include "Utils.hpp"
 
+#include <cstdlib>
+#include <algorithm>
+
 static std::string helpText =
-"Usage: buildsystem [options] <projectfile.xml>\n"
+"Usage: buildsystem [options] <projectfile.xml|workspace.xml>...\n"
 "Options:\n"
-"--help       - Display this help text\n"
-"--verbose    - Enable extended verbosity\n"
-"--version    - Display version information\n"
+"--help          - Display this help text\n"
+"--verbose       - Enable extended verbosity\n"
+"--version       - Display version information\n"
+"--history[=N]   - Show compile time changes over the last N builds (default 10)\n"
+"--stats=FILE    - Write process spawn and stat call counts as JSON to FILE\n"
+"--compiler=EXE  - Compile and link with EXE instead of the toolchain default\n"
+"--build-dir=DIR - Put objects, the executable and the project cache into DIR\n"
+"--config=NAME   - Build the <Configuration> NAME into <build dir>/NAME, 'all' builds every one at once\n"
+"--jobs=N, -jN   - Compile N sources at once (default: one per hardware thread)\n"
+"--fail-fast     - Stop all compiles at the first failure (default)\n"
+"--keep-going, -k - Compile everything possible and report all failures\n"
+"--batch[=N]     - Compile up to N (default 8) sources that were quick last time in one compiler run\n"
+"--direct        - Start the compiler driver's programs (cc1plus, as) directly, the driver is asked once with -###\n"
+"--time-trace    - Compile with Clang's -ftime-trace and report the most expensive headers and templates\n"
+"--analyze-includes - Report the headers whose removal saves the most build time, from GCC's -H and -ftime-report\n"
+"--affected FILE - List the sources depending on the files that follow, as of the last build\n"
 ;
 
 static std::string versionText =
 "Leo build system (version 1.0.0)\n"
 ;
 
+// Parses the count of an option such as --jobs=N, false unless it is a whole number above 0
+static bool ParseCount(const std::string& text, long& countOut)
+{
+    char* end = nullptr;
+    countOut = std::strtol(text.c_str(), &end, 10);
+    return !text.empty() && *end == '\0' && countOut > 0;
+}
+
 int main(int argc, char** argv)
 {
     Leo::BuildSystem buildSystem;
-    std::string fileToRead;
+    std::vector<std::string> filesToRead;
+    std::string buildDir;
+    size_t jobCount = 0;
+    int historyBuildCount = 0;
+    std::string statsFile;
+    bool affectedQuery = false;
+    std::vector<std::string> affectedFiles;
 
     if(argc < 2)
     {
@@ -45,9 +76,132 @@ int main(int argc, char** argv)
             continue;
         }
 
+        if(arg == "--history" || arg.rfind("--history=", 0) == 0)
+        {
+            historyBuildCount = 10;
+            if(arg.length() > std::string("--history=").length())
+            {
+                std::string count = arg.substr(std::string("--history=").length());
+                long value = 0;
+                if(!ParseCount(count, value))
+                {
+                    std::cout << "ERROR: --history=N needs a positive number of builds, got '" << count << "'\n";
+                    return EXIT_FAILURE;
+                }
+                historyBuildCount = static_cast<int>(std::min<long>(value, Leo::BuildHistory::Capacity));
+            }
+            continue;
+        }
+
+        if(arg.rfind("--stats=", 0) == 0)
+        {
+            statsFile = arg.substr(std::string("--stats=").length());
+            continue;
+        }
+
+        if(arg.rfind("--compiler=", 0) == 0)
+        {
+            buildSystem.SetCompilerPath(arg.substr(std::string("--compiler=").length()));
+            continue;
+        }
+
+        if(arg.rfind("--build-dir=", 0) == 0)
+        {
+            buildDir = arg.substr(std::string("--build-dir=").length());
+            buildSystem.SetBuildDir(buildDir);
+            continue;
+        }
+
+        if(arg.rfind("--config=", 0) == 0)
+        {
+            buildSystem.SetConfiguration(arg.substr(std::string("--config=").length()));
+            continue;
+        }
+
+        if(arg.rfind("--jobs=", 0) == 0 || arg.rfind("-j", 0) == 0)
+        {
+            std::string count;
+            if(arg == "-j")
+                count = (i + 1 < argc) ? argv[++i] : "";
+            else
+                count = arg.substr(arg[1] == 'j' ? 2 : std::string("--jobs=").length());
+
+            long value = 0;
+            if(!ParseCount(count, value))
+            {
+                std::cout << "ERROR: --jobs=N and -j N need a positive number of jobs, got '" << count << "'\n";
+                return EXIT_FAILURE;
+            }
+
+            jobCount = static_cast<size_t>(value);
+            buildSystem.SetJobCount(jobCount);
+            continue;
+        }
+
+        if(arg == "--fail-fast")
+        {
+            buildSystem.SetKeepGoing(false);
+            continue;
+        }
+
+        if(arg == "--keep-going" || arg == "-k")
+        {
+            buildSystem.SetKeepGoing(true);
+            continue;
+        }
+
+        if(arg == "--batch" || arg.rfind("--batch=", 0) == 0)
+        {
+            size_t batchSize = 8;
+            if(arg.length() > std::string("--batch=").length())
+            {
+                std::string count = arg.substr(std::string("--batch=").length());
+                long value = 0;
+                if(!ParseCount(count, value))
+                {
+                    std::cout << "ERROR: --batch=N needs a positive number of sources, got '" << count << "'\n";
+                    return EXIT_FAILURE;
+                }
+                batchSize = static_cast<size_t>(value);
+            }
+            buildSystem.SetBatchSize(batchSize);
+            continue;
+        }
+
+        if(arg == "--direct")
+        {
+            buildSystem.SetDirectCompile(true);
+            continue;
+        }
+
+        if(arg == "--time-trace")
+        {
+            buildSystem.SetTimeTrace(true);
+            continue;
+        }
+
+        if(arg == "--analyze-includes")
+        {
+            buildSystem.SetAnalyzeIncludes(true);
+            continue;
+        }
+
+        if(arg == "--affected")
+        {
+            affectedQuery = true;
+            continue;
+        }
+
+        // Queried files may have been deleted, everything after --affected is taken as is
+        if(affectedQuery)
+        {
+            affectedFiles.push_back(arg);
+            continue;
+        }
+
         if(Utils::PathExists(arg))
         {
-            fileToRead = arg;
+            filesToRead.push_back(arg);
             continue;
         }
         else
@@ -57,15 +211,75 @@ int main(int argc, char** argv)
         }
     }
 
-    if(fileToRead.empty())
+    // The project file may also come last: "--affected a.hpp b.hpp Project.xml"
+    if(affectedQuery && filesToRead.empty() && !affectedFiles.empty())
+    {
+        filesToRead.push_back(affectedFiles.back());
+        affectedFiles.pop_back();
+    }
+
+    if(filesToRead.empty())
     {
         std::cout << "No project files to read\n";
+        return EXIT_FAILURE;
+    }
+
+    // Several projects or a workspace file build together on one job pool
+    if(filesToRead.size() > 1 || Leo::Workspace::IsWorkspaceFile(filesToRead[0]))
+    {
+        if(historyBuildCount > 0 || affectedQuery)
+        {
+            std::cout << "--history and --affected take a single project file\n";
+            return EXIT_FAILURE;
+        }
+
+        std::cout << "------------[ Leo Build System ]------------\n";
+        Leo::Workspace workspace(buildSystem, buildDir, jobCount);
+        bool success = true;
+        for(const std::string& file : filesToRead)
+            success = success && workspace.AddFile(file);
+        if(success) success = workspace.Build();
+
+        if(!statsFile.empty())
+            Utils::WriteCounters(statsFile);
+
+        return success ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    std::string fileToRead = filesToRead[0];
+
+    if(historyBuildCount > 0)
+    {
+        if(!buildSystem.ReadProjectFile(fileToRead))
+            return EXIT_FAILURE;
+        buildSystem.DisplayHistory(historyBuildCount);
+        return 0;
+    }
+
+    if(affectedQuery)
+    {
+        if(!buildSystem.ReadProjectFile(fileToRead))
+            return EXIT_FAILURE;
+        buildSystem.DisplayAffectedSources(affectedFiles);
         return 0;
     }
 
     std::cout << "------------[ Leo Build System ]------------\n";
+
+    // Nothing changed since the last build, skip loading the project entirely
+    if(buildSystem.IsUpToDate(fileToRead))
+    {
+        std::cout << "All files are up to date\n";
+        if(!statsFile.empty())
+            Utils::WriteCounters(statsFile);
+        return 0;
+    }
+
     bool success = buildSystem.ReadProjectFile(fileToRead);
-    if(success) buildSystem.StartBuild();
+    if(success) success = buildSystem.StartBuild();
+
+    if(!statsFile.empty())
+        Utils::WriteCounters(statsFile);
 
-    return 0;
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file
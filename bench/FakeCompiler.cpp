@@ -0,0 +1,248 @@
+// Stand-in for g++ used to benchmark the build system without real compilation
+//
+// Understands the arguments ToolchainMinGW generates:
+//   -M -MT <target> -MF <file> -E <source>     write a depfile for <source>
+//   -c <sources> [-o <object>] [-MD -MF <file>] write fake objects (and depfiles)
+//   <objects> -o <binary>                       write a fake binary
+// Dependencies are found by following #include "..." lines through -I directories.
+//
+// Cost of every source is configured through the environment:
+//   LEO_FAKECC_MS      duration per source in milliseconds (default 10)
+//   LEO_FAKECC_MODE    "sleep" (default) or "burn" to spin the CPU
+//   LEO_FAKECC_MEM_MB  memory touched per source in megabytes (default 0)
+// and can be overridden per source with a comment line:
+//   // leo-fakecc: ms=<n> mem=<n> fail
+
+#include <set>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <filesystem>
+
+struct SourceCost
+{
+    int milliseconds = 10;
+    int memoryMB = 0;
+    bool fail = false;
+};
+
+static int EnvInt(const char* name, int fallback)
+{
+    const char* value = std::getenv(name);
+    return value ? std::atoi(value) : fallback;
+}
+
+static std::string DirectoryOf(const std::string& path)
+{
+    std::string::size_type pos = path.find_last_of('/');
+    return (pos == std::string::npos) ? std::string(".") : path.substr(0, pos);
+}
+
+static std::string StripExtension(const std::string& path)
+{
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    return name.substr(0, name.find_last_of('.'));
+}
+
+// Follows #include "..." recursively, system headers are not looked up
+static void CollectIncludes(const std::string& file, const std::vector<std::string>& includeDirs,
+                            std::set<std::string>& visited, std::vector<std::string>& depsOut)
+{
+    std::ifstream in(file);
+    std::string line;
+    while(std::getline(in, line))
+    {
+        std::string::size_type pos = line.find_first_not_of(" \t");
+        if(pos == std::string::npos || line.compare(pos, 8, "#include") != 0)
+            continue;
+
+        std::string::size_type open = line.find('"', pos);
+        std::string::size_type close = (open == std::string::npos) ? open : line.find('"', open + 1);
+        if(close == std::string::npos)
+            continue;
+
+        std::string name = line.substr(open + 1, close - open - 1);
+        std::vector<std::string> candidates;
+        candidates.push_back(DirectoryOf(file) + "/" + name);
+        for(const std::string& dir : includeDirs)
+            candidates.push_back(dir + "/" + name);
+
+        for(std::string candidate : candidates)
+        {
+            if(candidate.compare(0, 2, "./") == 0)
+                candidate = candidate.substr(2);
+            if(!std::filesystem::exists(candidate))
+                continue;
+
+            if(visited.insert(candidate).second)
+            {
+                depsOut.push_back(candidate);
+                CollectIncludes(candidate, includeDirs, visited, depsOut);
+            }
+            break;
+        }
+    }
+}
+
+static bool WriteDepfile(const std::string& path, const std::string& target, const std::string& source,
+                         const std::vector<std::string>& includeDirs)
+{
+    std::set<std::string> visited;
+    std::vector<std::string> deps;
+    CollectIncludes(source, includeDirs, visited, deps);
+
+    // Same layout g++ uses, continuation lines start with a space
+    std::ofstream out(path);
+    out << target << ": " << source;
+    for(const std::string& dep : deps)
+        out << " \\\n " << dep;
+    out << "\n";
+    return static_cast<bool>(out);
+}
+
+static SourceCost ReadSourceCost(const std::string& source)
+{
+    SourceCost cost;
+    cost.milliseconds = EnvInt("LEO_FAKECC_MS", 10);
+    cost.memoryMB = EnvInt("LEO_FAKECC_MEM_MB", 0);
+
+    std::ifstream in(source);
+    std::string line;
+    while(std::getline(in, line))
+    {
+        std::string::size_type pos = line.find("leo-fakecc:");
+        if(pos == std::string::npos)
+            continue;
+
+        std::stringstream options(line.substr(pos + 11));
+        std::string option;
+        while(options >> option)
+        {
+            if(option.compare(0, 3, "ms=") == 0) cost.milliseconds = std::atoi(option.c_str() + 3);
+            else if(option.compare(0, 4, "mem=") == 0) cost.memoryMB = std::atoi(option.c_str() + 4);
+            else if(option == "fail") cost.fail = true;
+        }
+    }
+
+    return cost;
+}
+
+static void SpendCost(const SourceCost& cost)
+{
+    std::vector<char> memory;
+    if(cost.memoryMB > 0)
+    {
+        // Touch every page so the memory actually becomes resident
+        memory.resize(static_cast<size_t>(cost.memoryMB) << 20);
+        for(size_t i = 0; i < memory.size(); i += 4096)
+            memory[i] = static_cast<char>(i);
+    }
+
+    const char* mode = std::getenv("LEO_FAKECC_MODE");
+    std::chrono::milliseconds duration(cost.milliseconds);
+    if(mode != nullptr && std::strcmp(mode, "burn") == 0)
+    {
+        volatile unsigned long sink = 0;
+        auto end = std::chrono::steady_clock::now() + duration;
+        while(std::chrono::steady_clock::now() < end)
+            for(int i = 0; i < 1000; i++) sink += i;
+    }
+    else
+    {
+        std::this_thread::sleep_for(duration);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> inputs;
+    std::vector<std::string> includeDirs;
+    std::string output;
+    std::string depTarget;
+    std::string depFile;
+    bool compileOnly = false;
+    bool dependencyOnly = false;
+    bool dependencySideEffect = false;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        auto next = [&]() { return (i + 1 < argc) ? std::string(argv[++i]) : std::string(); };
+
+        if(arg == "-c") compileOnly = true;
+        else if(arg == "-M" || arg == "-MM") dependencyOnly = true;
+        else if(arg == "-MD" || arg == "-MMD") dependencySideEffect = true;
+        else if(arg == "-MT") depTarget = next();
+        else if(arg == "-MF") depFile = next();
+        else if(arg == "-o") output = next();
+        else if(arg == "-E") continue;
+        else if(arg.compare(0, 2, "-I") == 0) includeDirs.push_back(arg.length() > 2 ? arg.substr(2) : next());
+        else if(arg[0] == '-') continue; // -D, -g, -W and friends change nothing here
+        else inputs.push_back(arg);
+    }
+
+    if(inputs.empty())
+    {
+        std::cerr << "leo_fakecc: no input files\n";
+        return 1;
+    }
+
+    for(const std::string& input : inputs)
+    {
+        if(!std::filesystem::exists(input))
+        {
+            std::cerr << "leo_fakecc: " << input << ": No such file or directory\n";
+            return 1;
+        }
+    }
+
+    if(dependencyOnly)
+    {
+        std::string target = depTarget.empty() ? StripExtension(inputs[0]) + ".o" : depTarget;
+        if(depFile.empty())
+            depFile = "/dev/stdout";
+        return WriteDepfile(depFile, target, inputs[0], includeDirs) ? 0 : 1;
+    }
+
+    if(compileOnly)
+    {
+        for(const std::string& source : inputs)
+        {
+            SourceCost cost = ReadSourceCost(source);
+            SpendCost(cost);
+            if(cost.fail)
+            {
+                std::cerr << source << ":1:1: error: leo_fakecc was asked to fail\n";
+                return 1;
+            }
+
+            std::string object = (!output.empty() && inputs.size() == 1) ? output : StripExtension(source) + ".o";
+            std::ofstream out(object, std::ios::binary);
+            out << "LEOFAKEOBJ " << source << "\n";
+
+            if(dependencySideEffect)
+            {
+                std::string path = (!depFile.empty() && inputs.size() == 1) ? depFile
+                                 : object.substr(0, object.find_last_of('.')) + ".d";
+                WriteDepfile(path, object, source, includeDirs);
+            }
+        }
+        return 0;
+    }
+
+    // Link step
+    if(output.empty())
+        output = "a.out";
+
+    std::ofstream out(output, std::ios::binary);
+    out << "#!/bin/sh\n# LEOFAKEBIN linked from " << inputs.size() << " objects\n";
+    out.close();
+    std::filesystem::permissions(output, std::filesystem::perms::owner_exec, std::filesystem::perm_options::add);
+    return 0;
+}
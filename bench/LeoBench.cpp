@@ -0,0 +1,250 @@
+// End to end build benchmark
+// Generates a synthetic project and measures clean, no-op and single header touch builds
+
+#include "ProjectGenerator.hpp"
+#include "Utils.hpp"
+
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#ifndef LEO_BUILDSYSTEM_PATH
+#define LEO_BUILDSYSTEM_PATH "BuildSystem"
+#endif
+
+#ifndef LEO_FAKECC_PATH
+#define LEO_FAKECC_PATH "leo_fakecc"
+#endif
+
+static std::string helpText =
+"Usage: leo_bench [options]\n"
+"Options:\n"
+"--sources=N       - Number of generated sources, 1 to 100000 (default 100)\n"
+"--fanout=N        - Headers included directly by each source (default 4)\n"
+"--depth=N         - Include chain depth below each header (default 3)\n"
+"--weight=N        - Functions per source, controls compile time (default 10)\n"
+"--repeat=N        - Repeat the no-op and touch builds N times (default 3)\n"
+"--dir=PATH        - Where to generate the project (default ./leo_bench_project)\n"
+"--buildsystem=EXE - Build system binary to benchmark\n"
+"--compiler=EXE    - Compiler the build system should use\n"
+"--fake            - Use leo_fakecc as the compiler, see bench/FakeCompiler.cpp\n"
+"--jobs=N          - Parallel compile jobs of the build system (default: its own default)\n"
+"--output=FILE     - Write JSON results to FILE instead of stdout\n"
+"--generate-only   - Only generate the project\n"
+;
+
+struct RunResult
+{
+    std::string scenario;
+    int exitCode = -1;
+    double wallSeconds = 0.0;
+    double cpuSeconds = 0.0;
+    uint64_t peakMemoryKB = 0;
+    uint64_t processSpawns = 0;
+    uint64_t statCalls = 0;
+};
+
+// Reads a numeric field from the flat JSON object written by --stats
+static uint64_t ReadStatsField(const std::string& json, const std::string& key)
+{
+    std::string::size_type pos = json.find("\"" + key + "\"");
+    if(pos == std::string::npos)
+        return 0;
+
+    pos = json.find(':', pos);
+    if(pos == std::string::npos)
+        return 0;
+
+    return std::strtoull(json.c_str() + pos + 1, nullptr, 10);
+}
+
+static RunResult RunBuild(const std::string& scenario, const std::string& buildSystem,
+                          const std::string& directory, const std::vector<std::string>& extraArgs,
+                          const std::string& projectFile)
+{
+    RunResult result;
+    result.scenario = scenario;
+
+    std::string statsFile = Utils::GetAbsolutePath(directory + "/LeoBenchStats.json");
+    std::filesystem::remove(statsFile);
+
+    std::vector<std::string> args = extraArgs;
+    args.push_back("--stats=" + statsFile);
+    args.push_back(projectFile);
+
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>(buildSystem.c_str()));
+    for(std::string& arg : args)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    auto startTime = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if(pid == -1)
+    {
+        std::cerr << "Failed to fork process\n";
+        return result;
+    }
+
+    if(pid == 0)
+    {
+        // Silence the build output, only the measurements matter
+        if(chdir(directory.c_str()) != 0 || !freopen("/dev/null", "w", stdout))
+            _exit(EXIT_FAILURE);
+        execv(argv[0], argv.data());
+        _exit(EXIT_FAILURE);
+    }
+
+    int status = 0;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+
+    result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    result.cpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1.0e6
+                      + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1.0e6;
+    // Covers the build system and every compiler it waited for
+    result.peakMemoryKB = static_cast<uint64_t>(usage.ru_maxrss);
+    result.exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    std::ifstream stats(statsFile);
+    std::stringstream json;
+    json << stats.rdbuf();
+    result.processSpawns = ReadStatsField(json.str(), "process_spawns");
+    result.statCalls = ReadStatsField(json.str(), "stat_calls");
+
+    return result;
+}
+
+// Bumps the modification time well past the last build so coarse timestamps still notice it
+static void TouchFile(const std::string& path)
+{
+    std::error_code error;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now() + std::chrono::seconds(2), error);
+}
+
+static RunResult Median(std::vector<RunResult> runs)
+{
+    std::sort(runs.begin(), runs.end(), [](const RunResult& a, const RunResult& b) {
+        return a.wallSeconds < b.wallSeconds;
+    });
+    return runs[runs.size() / 2];
+}
+
+int main(int argc, char** argv)
+{
+    LeoBench::ProjectGenerator::Options options;
+    std::string directory = "leo_bench_project";
+    std::string buildSystem = LEO_BUILDSYSTEM_PATH;
+    std::string outputFile;
+    std::vector<std::string> buildArgs;
+    bool generateOnly = false;
+    int repeat = 3;
+
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        std::string value = arg.substr(arg.find('=') + 1);
+
+        if(arg == "--help")
+        {
+            std::cout << helpText;
+            return 0;
+        }
+        else if(arg.rfind("--sources=", 0) == 0) options.sourceCount = std::clamp(std::atoi(value.c_str()), 1, 100000);
+        else if(arg.rfind("--fanout=", 0) == 0) options.includeFanOut = std::atoi(value.c_str());
+        else if(arg.rfind("--depth=", 0) == 0) options.headerDepth = std::atoi(value.c_str());
+        else if(arg.rfind("--weight=", 0) == 0) options.sourceWeight = std::atoi(value.c_str());
+        else if(arg.rfind("--repeat=", 0) == 0) repeat = std::max(1, std::atoi(value.c_str()));
+        else if(arg.rfind("--dir=", 0) == 0) directory = value;
+        else if(arg.rfind("--buildsystem=", 0) == 0) buildSystem = value;
+        else if(arg.rfind("--output=", 0) == 0) outputFile = value;
+        else if(arg.rfind("--compiler=", 0) == 0) buildArgs.push_back("--compiler=" + Utils::GetAbsolutePath(value));
+        else if(arg == "--fake") buildArgs.push_back("--compiler=" + Utils::GetAbsolutePath(LEO_FAKECC_PATH));
+        else if(arg.rfind("--jobs=", 0) == 0) buildArgs.push_back(arg);
+        else if(arg == "--generate-only") generateOnly = true;
+        else std::cerr << "Skipping unknown command: " << arg << "\n";
+    }
+
+    buildSystem = Utils::GetAbsolutePath(buildSystem);
+
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+
+    LeoBench::ProjectGenerator generator;
+    std::cerr << "Generating " << options.sourceCount << " sources in " << directory << "\n";
+    if(!generator.Generate(directory, options))
+        return 1;
+
+    if(generateOnly)
+        return 0;
+
+    std::vector<RunResult> results;
+
+    std::cerr << "Running clean build\n";
+    results.push_back(RunBuild("clean", buildSystem, directory, buildArgs, generator.GetProjectFile()));
+
+    std::vector<RunResult> noopRuns;
+    std::vector<RunResult> leafRuns;
+    std::vector<RunResult> sharedRuns;
+    for(int i = 0; i < repeat; i++)
+    {
+        std::cerr << "Running no-op and header touch builds (" << i + 1 << "/" << repeat << ")\n";
+        noopRuns.push_back(RunBuild("noop", buildSystem, directory, buildArgs, generator.GetProjectFile()));
+
+        TouchFile(directory + "/" + generator.GetLeafHeader());
+        leafRuns.push_back(RunBuild("touch_leaf_header", buildSystem, directory, buildArgs, generator.GetProjectFile()));
+
+        TouchFile(directory + "/" + generator.GetSharedHeader());
+        sharedRuns.push_back(RunBuild("touch_shared_header", buildSystem, directory, buildArgs, generator.GetProjectFile()));
+    }
+    results.push_back(Median(noopRuns));
+    results.push_back(Median(leafRuns));
+    results.push_back(Median(sharedRuns));
+
+    std::string joinedArgs;
+    for(const std::string& arg : buildArgs)
+        joinedArgs += (joinedArgs.empty() ? "" : " ") + arg;
+
+    std::stringstream json;
+    json << std::fixed << std::setprecision(6);
+    json << "{\n"
+         << "  \"git_head\": \"" << Utils::EscapeJson(Utils::GetGitHead(".")) << "\",\n"
+         << "  \"sources\": " << options.sourceCount << ",\n"
+         << "  \"fanout\": " << options.includeFanOut << ",\n"
+         << "  \"depth\": " << options.headerDepth << ",\n"
+         << "  \"weight\": " << options.sourceWeight << ",\n"
+         << "  \"repeat\": " << repeat << ",\n"
+         << "  \"build_args\": \"" << Utils::EscapeJson(joinedArgs) << "\",\n"
+         << "  \"results\": [\n";
+    for(size_t i = 0; i < results.size(); i++)
+    {
+        const RunResult& result = results[i];
+        json << "    {\"scenario\": \"" << result.scenario << "\""
+             << ", \"exit_code\": " << result.exitCode
+             << ", \"wall_seconds\": " << result.wallSeconds
+             << ", \"cpu_seconds\": " << result.cpuSeconds
+             << ", \"peak_rss_kb\": " << result.peakMemoryKB
+             << ", \"process_spawns\": " << result.processSpawns
+             << ", \"stat_calls\": " << result.statCalls
+             << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    json << "  ]\n}\n";
+
+    if(outputFile.empty())
+    {
+        std::cout << json.str();
+    }
+    else
+    {
+        std::ofstream file(outputFile);
+        file << json.str();
+    }
+
+    return 0;
+}
@@ -0,0 +1,253 @@
+// Micro benchmarks of the code that runs once per file per build
+// Reports time, heap allocations and allocated bytes per operation
+
+#include "BuildSystem.hpp"
+#include "Compilers.hpp"
+#include "Fingerprint.hpp"
+#include "Manifest.hpp"
+#include "Utils.hpp"
+
+#include <new>
+#include <cstdlib>
+#include <iomanip>
+#include <functional>
+
+static std::atomic<uint64_t> allocationCount{0};
+static std::atomic<uint64_t> allocationBytes{0};
+
+void* operator new(std::size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    if(void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+static std::string filter;
+
+// Keeps the optimizer from discarding the benchmarked work
+template<typename T>
+static void DoNotOptimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Runs 'body' until at least 'minSeconds' passed, 'opsPerCall' operations happen per call
+static void Benchmark(const std::string& name, size_t opsPerCall, const std::function<void()>& body, double minSeconds = 0.3)
+{
+    if(!filter.empty() && name.find(filter) == std::string::npos)
+        return;
+
+    body(); // Warm up caches
+
+    uint64_t calls = 0;
+    uint64_t startCount = allocationCount.load();
+    uint64_t startBytes = allocationBytes.load();
+    auto startTime = std::chrono::steady_clock::now();
+    double elapsed = 0.0;
+
+    do
+    {
+        body();
+        calls++;
+        elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    } while(elapsed < minSeconds);
+
+    double ops = static_cast<double>(calls * opsPerCall);
+    std::cout << std::left << std::setw(44) << name << std::right << std::fixed
+              << std::setw(12) << std::setprecision(1) << elapsed * 1.0e9 / ops << " ns/op"
+              << std::setw(10) << std::setprecision(2) << (allocationCount.load() - startCount) / ops << " allocs/op"
+              << std::setw(12) << std::setprecision(1) << (allocationBytes.load() - startBytes) / ops << " B/op\n";
+}
+
+// Dependency list in the shape 'g++ -M' writes for a typical source of this repository,
+// one path per line after the rule's target
+static std::string MakeDepfileData(int userHeaders, int systemHeaders)
+{
+    std::string data;
+    for(int i = 0; i < userHeaders; i++)
+        data += " include/module" + std::to_string(i / 8) + "/Header" + std::to_string(i) + ".hpp \\\n";
+    for(int i = 0; i < systemHeaders; i++)
+        data += " /usr/include/c++/12/bits/header_" + std::to_string(i) + ".h \\\n";
+    data += " /home/someone/some\\ long\\ folder\\ name/file.hpp\n";
+    return data;
+}
+
+static std::vector<std::string> MakePathList(int count)
+{
+    std::vector<std::string> paths;
+    paths.reserve(count);
+    for(int i = 0; i < count; i++)
+    {
+        paths.push_back("/home/builder/workspace/project/src/subsystem" + std::to_string(i % 37)
+                        + "/module" + std::to_string(i % 11) + "/SourceFile" + std::to_string(i) + ".cpp");
+    }
+    return paths;
+}
+
+int main(int argc, char** argv)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if(arg.rfind("--filter=", 0) == 0)
+        {
+            filter = arg.substr(std::string("--filter=").length());
+        }
+        else
+        {
+            std::cout << "Usage: leo_microbench [--filter=SUBSTRING]\n";
+            return 0;
+        }
+    }
+
+    std::string workDir = (std::filesystem::temp_directory_path() / "leo_microbench").string();
+    std::filesystem::remove_all(workDir);
+    std::filesystem::create_directories(workDir);
+
+    // Dependency parsing
+    {
+        Leo::ToolchainMinGW toolchain;
+        std::string smallDeps = MakeDepfileData(10, 0);
+        std::string largeDeps = MakeDepfileData(60, 240);
+        std::vector<std::string> deps;
+
+        Benchmark("MakeDependencyTree/11 deps", 1, [&]() {
+            toolchain.MakeDependencyTree(smallDeps, deps);
+            DoNotOptimize(deps.data());
+        });
+
+        Benchmark("MakeDependencyTree/301 deps", 1, [&]() {
+            toolchain.MakeDependencyTree(largeDeps, deps);
+            DoNotOptimize(deps.data());
+        });
+    }
+
+    // Path helpers
+    {
+        std::vector<std::string> paths = MakePathList(10000);
+
+        Benchmark("Utils::NormalizePath", paths.size(), [&]() {
+            for(const std::string& path : paths)
+                DoNotOptimize(Utils::NormalizePath(path).size());
+        });
+
+        Benchmark("Utils::StripFileName", paths.size(), [&]() {
+            for(const std::string& path : paths)
+                DoNotOptimize(Utils::StripFileName(path).size());
+        });
+
+        Benchmark("Utils::StripFilePath", paths.size(), [&]() {
+            for(const std::string& path : paths)
+                DoNotOptimize(Utils::StripFilePath(path).size());
+        });
+    }
+
+    // Content hashing for ChangeDetection, the tokenizer should keep up with the raw hash
+    {
+        std::string header;
+        while(header.size() < 1024 * 1024)
+        {
+            int i = static_cast<int>(header.size());
+            header += "// Comment line " + std::to_string(i) + " describing the next declaration\n"
+                      "    inline int Function" + std::to_string(i) + "(const std::string& text, int count = 0x1'000)\n"
+                      "    {\n        return static_cast<int>(text.find(\"needle\\\"\")) + count; /* done */\n    }\n\n";
+        }
+
+        Benchmark("Utils::HashString/1 MB header", 1, [&]() {
+            DoNotOptimize(Utils::HashString(header));
+        });
+
+        Benchmark("GetTokenFingerprint/1 MB header", 1, [&]() {
+            DoNotOptimize(Leo::GetTokenFingerprint(header, true));
+        });
+    }
+
+    // File time queries
+    {
+        std::vector<std::string> files;
+        for(int i = 0; i < 10000; i++)
+        {
+            std::string dir = workDir + "/files/d" + std::to_string(i / 500);
+            if(i % 500 == 0)
+                std::filesystem::create_directories(dir);
+            files.push_back(dir + "/file" + std::to_string(i) + ".hpp");
+            std::ofstream(files.back()) << "\n";
+        }
+
+        std::filesystem::file_time_type referenceTime = std::filesystem::file_time_type::clock::now();
+
+        Benchmark("Utils::GetFileModifiedTime/10k files", files.size(), [&]() {
+            for(const std::string& file : files)
+                DoNotOptimize(Utils::GetFileModifiedTime(file));
+        });
+
+        Benchmark("Utils::FileModified/10k files", files.size(), [&]() {
+            for(const std::string& file : files)
+                DoNotOptimize(Utils::FileModified(file, referenceTime));
+        });
+    }
+
+    // Project loading
+    {
+        std::string projectFile = workDir + "/Project.xml";
+        std::ofstream project(projectFile);
+        project << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<Project Name=\"Bench\">\n<Sources>\n";
+        for(const std::string& path : MakePathList(5000))
+            project << "<Item>" << path << "</Item>\n";
+        project << "</Sources>\n<Headers>\n";
+        for(int i = 0; i < 2000; i++)
+            project << "<Item>include/Header" << i << ".hpp</Item>\n";
+        project << "</Headers>\n"
+                << "<CompilerOptions><Flags><Item>-O2</Item><Item>-Wall</Item></Flags>"
+                << "<Include><Item>include</Item></Include><Defines><Item>NDEBUG</Item></Defines></CompilerOptions>\n"
+                << "<LinkerOptions><Flags></Flags><Libraries><Item>m</Item></Libraries><Include></Include></LinkerOptions>\n"
+                << "</Project>\n";
+        project.close();
+
+        Benchmark("BuildSystem::ReadProjectFile/7k items", 1, [&]() {
+            Leo::BuildSystem buildSystem;
+            DoNotOptimize(buildSystem.ReadProjectFile(projectFile));
+        });
+    }
+
+    // No-op build check, the target is below 50 ms for 50k files
+    if(filter.empty() || std::string("BuildManifest").find(filter) != std::string::npos)
+    {
+        std::string manifestFile = workDir + "/manifest";
+        Leo::BuildManifest manifest;
+        for(int i = 0; i < 50000; i++)
+        {
+            std::string dir = workDir + "/manifest_files/d" + std::to_string(i / 1000);
+            if(i % 1000 == 0)
+                std::filesystem::create_directories(dir);
+            std::string file = dir + "/file" + std::to_string(i) + ".hpp";
+            std::ofstream(file) << "\n";
+            manifest.AddFile(file);
+        }
+        manifest.SetOptionsHash(1);
+        manifest.Finalize();
+        manifest.Save(manifestFile);
+
+        Benchmark("BuildManifest::IsUpToDate/50k files", 1, [&]() {
+            Leo::BuildManifest loaded;
+            loaded.Load(manifestFile);
+            if(!loaded.IsUpToDate(1))
+                std::cout << "ERROR: MicroBench: Manifest unexpectedly out of date\n";
+        });
+    }
+
+    std::filesystem::remove_all(workDir);
+    return 0;
+}
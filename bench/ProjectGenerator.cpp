@@ -0,0 +1,145 @@
+#include "ProjectGenerator.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+
+namespace LeoBench
+{
+    bool ProjectGenerator::Generate(std::string directory, const Options& options)
+    {
+        int sourceCount = std::max(1, options.sourceCount);
+        int fanOut = std::max(1, options.includeFanOut);
+        int depth = std::max(1, options.headerDepth);
+
+        std::error_code error;
+        std::filesystem::create_directories(directory + "/include", error);
+        std::filesystem::create_directories(directory + "/src", error);
+        if(error)
+        {
+            std::cout << "ERROR: ProjectGenerator: Failed to create directory: " << directory << "\n";
+            return false;
+        }
+
+        mSources.clear();
+        mHeaders.clear();
+
+        // Every source includes the shared config header and (fanOut - 1) headers of the first
+        // level. Each of those starts an include chain 'depth' levels deep. The header count per
+        // level grows with the project so fan-in stays realistic at large source counts
+        int headersPerLevel = std::clamp(sourceCount / 4, fanOut, 4096);
+
+        mSharedHeader = "include/config.hpp";
+        mLeafHeader = "include/leaf.hpp";
+        mHeaders.push_back(mSharedHeader);
+        mHeaders.push_back(mLeafHeader);
+
+        {
+            std::ofstream file(directory + "/" + mSharedHeader);
+            file << "#pragma once\n#define BENCH_CONFIG_VALUE 3\n";
+        }
+
+        {
+            std::ofstream file(directory + "/" + mLeafHeader);
+            file << "#pragma once\ninline int LeafValue() { return 7; }\n";
+        }
+
+        for(int level = 0; level < depth; level++)
+        {
+            std::filesystem::create_directories(directory + "/include/l" + std::to_string(level), error);
+            for(int i = 0; i < headersPerLevel; i++)
+            {
+                std::string name = "l" + std::to_string(level) + "/h" + std::to_string(i) + ".hpp";
+                mHeaders.push_back("include/" + name);
+
+                std::ofstream file(directory + "/include/" + name);
+                file << "#pragma once\n";
+                if(level + 1 < depth)
+                    file << "#include \"l" << level + 1 << "/h" << i << ".hpp\"\n";
+                file << "struct Type_" << level << "_" << i << "\n{\n"
+                     << "    int value = " << i << ";\n"
+                     << "    int Get() const { return value * BENCH_CONFIG_VALUE; }\n"
+                     << "};\n";
+            }
+        }
+
+        for(int i = 0; i < sourceCount; i++)
+        {
+            // Keep directories reasonably small at 100k sources
+            std::string dir = "src/g" + std::to_string(i / 1000);
+            std::filesystem::create_directories(directory + "/" + dir, error);
+
+            std::string name = (i == 0) ? std::string("src/main.cpp") : dir + "/unit" + std::to_string(i) + ".cpp";
+            mSources.push_back(name);
+
+            // leo_fakecc charges a millisecond per generated function
+            std::ofstream file(directory + "/" + name);
+            file << "// leo-fakecc: ms=" << options.sourceWeight << "\n";
+            file << "#include \"config.hpp\"\n";
+            for(int k = 0; k < fanOut - 1; k++)
+                file << "#include \"l0/h" << (i * (fanOut - 1) + k) % headersPerLevel << ".hpp\"\n";
+            if(i == 0)
+                file << "#include \"leaf.hpp\"\n";
+
+            for(int f = 0; f < options.sourceWeight; f++)
+            {
+                file << "int Function_" << i << "_" << f << "(int x)\n{\n"
+                     << "    int sum = 0;\n"
+                     << "    for(int k = 0; k < x; k++)\n"
+                     << "        sum += (k * " << f + 1 << ") ^ (sum >> 1);\n"
+                     << "    return sum;\n"
+                     << "}\n";
+            }
+
+            if(i == 0)
+                file << "int main() { return LeafValue() - 7; }\n";
+        }
+
+        std::ofstream project(directory + "/" + mProjectFile);
+        project << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                << "<Project Name=\"Bench\">\n"
+                << "    <Sources>\n";
+        for(const std::string& source : mSources)
+            project << "        <Item>" << source << "</Item>\n";
+        project << "    </Sources>\n"
+                << "    <Headers>\n";
+        for(const std::string& header : mHeaders)
+            project << "        <Item>" << header << "</Item>\n";
+        project << "    </Headers>\n"
+                << "    <CompilerOptions>\n"
+                << "        <Flags>\n"
+                << "            <Item>-O0</Item>\n"
+                << "        </Flags>\n"
+                << "        <Include>\n"
+                << "            <Item>include</Item>\n"
+                << "        </Include>\n"
+                << "        <Defines>\n"
+                << "        </Defines>\n"
+                << "    </CompilerOptions>\n"
+                << "    <LinkerOptions>\n"
+                << "        <Flags>\n"
+                << "        </Flags>\n"
+                << "        <Libraries>\n"
+                << "        </Libraries>\n"
+                << "        <Include>\n"
+                << "        </Include>\n"
+                << "    </LinkerOptions>\n"
+                << "</Project>\n";
+
+        return static_cast<bool>(project);
+    }
+
+    std::string ProjectGenerator::GetProjectFile() const
+    {
+        return mProjectFile;
+    }
+
+    std::string ProjectGenerator::GetSharedHeader() const
+    {
+        return mSharedHeader;
+    }
+
+    std::string ProjectGenerator::GetLeafHeader() const
+    {
+        return mLeafHeader;
+    }
+}
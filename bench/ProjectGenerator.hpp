@@ -0,0 +1,47 @@
+#ifndef PROJECTGENERATOR_H_
+#define PROJECTGENERATOR_H_
+
+#include <vector>
+#include <string>
+
+namespace LeoBench
+{
+    // Writes a synthetic project in the Sample.xml format
+    class ProjectGenerator
+    {
+    public:
+        ProjectGenerator() = default;
+        ~ProjectGenerator() = default;
+
+        struct Options
+        {
+            // Number of translation units, main.cpp included
+            int sourceCount = 100;
+            // Headers included directly by every source
+            int includeFanOut = 4;
+            // Length of the include chain below each directly included header
+            int headerDepth = 3;
+            // Functions generated into every source, controls compile time
+            int sourceWeight = 10;
+        };
+
+        bool Generate(std::string directory, const Options& options);
+
+        // Path of the project file relative to the generated directory
+        std::string GetProjectFile() const;
+        // Header that every source depends on, touching it dirties the whole project
+        std::string GetSharedHeader() const;
+        // Header with the fewest dependents, touching it dirties a single source
+        std::string GetLeafHeader() const;
+
+    private:
+        std::string mProjectFile = "Project.xml";
+        std::string mSharedHeader;
+        std::string mLeafHeader;
+
+        std::vector<std::string> mSources;
+        std::vector<std::string> mHeaders;
+    };
+}
+
+#endif // PROJECTGENERATOR_H_
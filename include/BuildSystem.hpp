@@ -3,9 +3,17 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <future>
+#include <unordered_map>
+
+#include "Fingerprint.hpp"
+#include "Compilers.hpp"
 
 namespace Leo
 {
+    class JobPool;
+
     class BuildSystem
     {
     public:
@@ -19,13 +27,82 @@ namespace Leo
         };
 
         bool ReadProjectFile(std::string filepath);
-        void StartBuild();
+
+        // Checks the manifest of the last build, doesn't need the project file to be read
+        bool IsUpToDate(std::string filepath);
+
+        // False if any compile or link step failed. 'jobPool' is shared with other projects or null
+        bool StartBuild(JobPool* jobPool = nullptr);
         void DisplayBuildInfo();
+        void DisplayHistory(int buildCount);
+
+        // Lists the sources that have to be recompiled if any of 'files' changes
+        void DisplayAffectedSources(const std::vector<std::string>& files);
 
         void SetVerbosity(VerbosityLevel level);
+        void SetCompilerPath(std::string compilerPath);
+        void SetJobCount(size_t jobCount);
+        void SetKeepGoing(bool option);
+
+        // Compiles up to 'batchSize' sources that compiled quickly last time in one compiler run, 0 or 1 turns it off
+        void SetBatchSize(size_t batchSize);
+
+        // Starts the compiler driver's programs directly, the driver is only asked once for them
+        void SetDirectCompile(bool option);
+
+        // Compiles with -ftime-trace and reports the most expensive headers and template instantiations, Clang only
+        void SetTimeTrace(bool option);
+
+        // Instead of building, runs GCC's front end on every source with -H and -ftime-report and reports
+        // the headers whose removal would save the most build time
+        void SetAnalyzeIncludes(bool option);
+
+        // Objects, the executable and the project cache go to 'buildDir' instead of the working directory
+        // and the project root, so several build directories of one project can coexist
+        void SetBuildDir(std::string buildDir);
+
+        // Builds a <Configuration> of the project into <build dir>/<name> instead of the project's own options,
+        // "all" builds every configuration at once on a shared job pool
+        void SetConfiguration(std::string name);
+
+        std::string GetProjectName() const;
+
+        // Names of the projects listed in the project's <Dependencies>, only used within a workspace
+        const std::vector<std::string>& GetProjectDependencies() const;
+
+        // Links of this project wait for 'built' and take in the library targets of 'project'
+        void AddProjectDependency(const BuildSystem* project, std::shared_future<bool> built);
+
+        // Outputs of the library targets of a configuration, each one before the libraries it uses.
+        // Recorded by the build, or taken from the cached toolchain answers if the project was up to date
+        std::vector<std::string> GetLibraryOutputs(const std::string& configurationName) const;
 
     private:
+        // Options of one build, the project's own or those of a <Configuration> replacing some of them
+        struct Configuration
+        {
+            std::string name;
+            std::vector<std::string> compilerFlags;
+            std::vector<std::string> compilerDefines;
+            std::vector<std::string> compilerIncludeDirectories;
+            std::vector<std::string> linkerFlags;
+            std::vector<std::string> linkerLibraries;
+            std::vector<std::string> linkerIncludeDirectories;
+        };
+
+        // A <Target>, every target compiles at once and only its link waits for the libraries it uses
+        struct Target
+        {
+            std::string name;
+            TargetType type = TargetType::Executable;
+            std::vector<std::string> sources;
+
+            // Indices into mTargets
+            std::vector<size_t> dependencies;
+        };
+
         std::string mProjectName;
+        std::string mProjectFile;
         std::string mProjectRootDir;
         std::string mProjectCacheDir;
 
@@ -39,9 +116,82 @@ namespace Leo
         std::vector<std::string> mLinkerLibraries;
         std::vector<std::string> mLinkerIncludeDirectories;
 
+        // Empty means the toolchain default
+        std::string mCompilerPath;
+
+        // Empty means the working directory
+        std::string mBuildDir;
+
+        std::vector<Configuration> mConfigurations;
+        std::string mConfigurationName;
+
+        // Empty if the project's sources make up a single executable
+        std::vector<Target> mTargets;
+
+        struct ProjectDependency
+        {
+            const BuildSystem* project = nullptr;
+            std::shared_future<bool> built;
+        };
+
+        std::vector<std::string> mProjectDependencyNames;
+        std::vector<ProjectDependency> mProjectDependencies;
+
+        // Library outputs of every configuration built, as named by its toolchain. Entries are added before
+        // the configurations build side by side, each build only fills its own
+        std::unordered_map<std::string, std::vector<std::string>> mLibraryOutputs;
+
+        // A <Pool> of <ResourcePools>, at most 'depth' of its jobs run at once whatever --jobs says
+        struct ResourcePool
+        {
+            std::string name;
+            size_t depth = 1;
+            // Sources whose last recorded peak memory reached it join the pool, 0 if unused
+            uint32_t minMemoryKB = 0;
+            std::vector<std::string> sources;
+        };
+
+        std::vector<ResourcePool> mResourcePools;
+
+        ChangeDetection mChangeDetection = ChangeDetection::Timestamps;
+
+        // 0 means one job per hardware thread
+        size_t mJobCount = 0;
+        bool mKeepGoing = false;
+        size_t mBatchSize = 0;
+        bool mDirectCompile = false;
+        bool mTimeTrace = false;
+        bool mAnalyzeIncludes = false;
+
         VerbosityLevel mVerbosityLevel = VerbosityLevel::Min;
 
+        // Sources compiling faster than this are batched with SetBatchSize()
+        static constexpr float SmallSourceSeconds = 0.5f;
+
+        // Headers printed by SetAnalyzeIncludes(), the report file has all of them
+        static constexpr size_t IncludeReportSize = 20;
+
         bool VerifyProjectStructure(std::string filepath);
+        uint64_t GetOptionsHash(const std::string& configurationName);
+
+        // Both take an empty name for the project's own options
+        std::string GetBuildDir(const std::string& configurationName) const;
+        std::string GetCacheDir(const std::string& projectFile, const std::string& configurationName) const;
+
+        // Indices of the library targets, each one before the libraries it uses
+        std::vector<size_t> GetLibraryOrder() const;
+
+        // Compiles and links one configuration, 'jobPool' is shared with the other configurations or null
+        bool Build(Configuration configuration, JobPool* jobPool);
+
+        // Limits of every pool and the pool of every source assigned to one, by listing or by the memory
+        // it needed the last time it was compiled
+        void GetResourcePools(const std::string& cacheDir, std::unordered_map<std::string, size_t>& limitsOut,
+                              std::unordered_map<std::string, std::string>& sourcePoolsOut);
+
+        // Libraries a target links against, each one after every library using it. Static libraries bring
+        // their own dependencies along, shared ones were linked against theirs already
+        std::vector<size_t> GetLinkOrder(size_t targetIndex);
     };
 }
 
@@ -3,9 +3,30 @@
 
 #include <vector>
 #include <string>
+#include <functional>
+#include <unordered_map>
+
+#include "History.hpp"
+#include "FileService.hpp"
+#include "Fingerprint.hpp"
+#include "DependencyState.hpp"
+#include "DirectCompile.hpp"
+#include "ToolchainProbe.hpp"
+#include "SystemHeaders.hpp"
 
 namespace Leo
 {
+    class JobPool;
+    class IncludeAnalysis;
+
+    // What Link() produces from the objects
+    enum class TargetType
+    {
+        Executable,
+        StaticLibrary,
+        SharedLibrary
+    };
+
     class ToolchainBase
     {
     public:
@@ -33,16 +54,75 @@ namespace Leo
         // Set to true to recompile entire project
         void SetCleanFlag(bool option);
 
+        // Program used to compile and link, found through PATH unless it is a path
+        void SetCompilerPath(std::string compilerPath);
+
+        // Objects go to <buildDir>/obj, the executable to <buildDir>/bin
+        void SetBuildDir(std::string buildDir);
+
+        // Objects of a named target go to obj/<name>, so targets sharing a source don't share its object.
+        // Libraries are named lib<name>.a and lib<name>.so (<name>.dll on Windows)
+        void SetTarget(std::string name, TargetType type);
+
+        void SetChangeDetection(ChangeDetection option);
+
+        // Number of sources compiled at once, 0 means one per hardware thread
+        void SetJobCount(size_t jobCount);
+
+        // Compile everything possible instead of stopping at the first failure
+        void SetKeepGoing(bool option);
+
+        // Compiles on a pool shared with other builds instead of one with SetJobCount() workers.
+        // Fail-fast then stops every build using the pool
+        void SetJobPool(JobPool* jobPool);
+
+        // Compiles of the sources in 'sourcePools' run as jobs of the named resource, 'limits' are set on the pool
+        void SetResourcePools(std::unordered_map<std::string, size_t> limits, std::unordered_map<std::string, std::string> sourcePools);
+
+        // Up to 'maxBatchSize' of the sources in 'smallSources' (with their usual compile time in seconds) share
+        // one compiler run, so the driver starts once for all of them. A failed batch is compiled again one by one
+        void SetCompileBatching(size_t maxBatchSize, std::unordered_map<std::string, float> smallSources);
+
+        // Start the programs the compiler driver would start for a compile directly, see DirectCompileCache
+        void SetDirectCompile(bool option);
+
+        // What the compiler reported about itself. Its identity is part of every command digest,
+        // the target decides output names and the archiver
+        void SetToolchainProbe(const ToolchainProbe& probe);
+
+        // Compile with -ftime-trace and report the most expensive headers and template instantiations.
+        // Only toolchains based on Clang support it
+        void SetTimeTrace(bool option);
+
         virtual bool SetupState();
-        virtual std::vector<std::string> Compile();
-        virtual void Link(std::string outFileName, std::vector<std::string>& objectFiles);
+        // Both return false if a compiler or linker run failed
+        virtual bool Compile(std::vector<std::string>& objectFiles);
+        virtual bool Link(std::string outFileName, std::vector<std::string>& objectFiles);
+
+        // Runs the compiler front end on every source with -H and -ftime-report and adds what it prints to
+        // 'analysis'. Nothing is built. False if a source failed to compile or the toolchain can't do it
+        virtual bool AnalyzeIncludes(IncludeAnalysis& analysis);
 
-        virtual std::vector<std::string> ExamineSources();
+        // Reports every source that has to be recompiled as soon as it is found
+        virtual void ExamineSources(const std::function<void(const std::string&)>& onChanged);
         virtual void MakeDependencyTree(std::string depsData, std::vector<std::string>& depsOut);
 
+        // Per source statistics of the last Compile() call
+        std::vector<BuildHistory::SourceRecord>& GetSourceRecords();
+
+        // Dependencies of every source known after the last Compile() call
+        std::unordered_map<std::string, std::vector<std::string>>& GetDependencies();
+
+        virtual std::string GetObjectPath(const std::string& source);
+        virtual std::string GetBinaryPath(const std::string& outFileName);
 
     protected:
         std::string mName = "Dummy Compiler";
+        std::string mCompilerPath = "g++";
+        std::string mArchiverPath = "ar";
+        std::string mBuildDir = ".";
+        std::string mTargetName;
+        TargetType mTargetType = TargetType::Executable;
         std::string mProjectRootDir;
         std::string mProjectCacheDir;
 
@@ -57,6 +137,43 @@ namespace Leo
         std::vector<std::string> mLinkerIncludeDirectories;
 
         bool mCleanBuild;
+        ChangeDetection mChangeDetection = ChangeDetection::Timestamps;
+        size_t mJobCount = 0;
+        bool mKeepGoing = false;
+        JobPool* mJobPool = nullptr;
+        std::unordered_map<std::string, size_t> mResourceLimits;
+        std::unordered_map<std::string, std::string> mSourcePools;
+        size_t mBatchSize = 0;
+        std::unordered_map<std::string, float> mBatchSources;
+        bool mDirectCompile = false;
+        ToolchainProbe mToolchainProbe;
+        bool mTimeTrace = false;
+
+        std::vector<BuildHistory::SourceRecord> mSourceRecords;
+        std::unordered_map<std::string, std::vector<std::string>> mDependencies;
+
+        // Dependency digests of the last successful compile of every source
+        DependencyState mDependencyState;
+
+        // Headers of the system include directories, kept out of mDependencyState
+        SystemHeaderState mSystemHeaders;
+
+        // Content digests of this build, reads for token fingerprints are batched
+        std::unordered_map<std::string, uint64_t> mContentDigests;
+
+        // Parses a makefile rule written by -M or -MD, the source itself is left out
+        bool ReadDependencyFile(std::string path, std::vector<std::string>& depsOut);
+        bool ParseDependencyRule(std::string rule, std::vector<std::string>& depsOut);
+
+        // Combined content digests of the source and everything it includes
+        uint64_t GetDependencyDigest(const std::string& source);
+
+        // Stamp digest of the file, or its token fingerprint with a token based ChangeDetection
+        uint64_t GetContentDigest(const std::string& path);
+        uint64_t MakeContentDigest(const std::string& path, const std::string& contents);
+
+        // Hash of the program and every argument it is started with, a different flag rebuilds the output
+        uint64_t GetCommandDigest(const std::vector<std::string>& arguments);
     };
 
     class ToolchainMinGW : public ToolchainBase
@@ -66,14 +183,65 @@ namespace Leo
         ~ToolchainMinGW() = default;
 
         bool SetupState() override;
-        std::vector<std::string> Compile() override;
-        void Link(std::string outFileName, std::vector<std::string>& objectFiles) override;
+        bool Compile(std::vector<std::string>& objectFiles) override;
+        bool Link(std::string outFileName, std::vector<std::string>& objectFiles) override;
+        bool AnalyzeIncludes(IncludeAnalysis& analysis) override;
 
-        std::vector<std::string> ExamineSources() override;
+        void ExamineSources(const std::function<void(const std::string&)>& onChanged) override;
         void MakeDependencyTree(std::string depsData, std::vector<std::string>& depsOut) override;
 
     protected:
         std::string mName = "MinGW";
+
+        // Arguments shared by every source, set up by SetupCompileCommand()
+        std::vector<std::string> mCompileCommand;
+        virtual void SetupCompileCommand();
+
+        // Traces and reports need one driver run per source, -o names the trace file
+        bool UsesSingleCompiles() const;
+
+        DirectCompileCache mDirectCompileCache;
+
+        // Full argument list compiling a single source
+        std::vector<std::string> GetCompileArguments(const std::string& source);
+
+        // Compiles a single source with the arguments of GetCompileArguments(), through the driver or
+        // by starting its programs directly. Returns the exit code of the first one failing
+        int RunCompile(const std::string& source, const std::vector<std::string>& arguments, Utils::ProcessStats& statsOut);
+
+        // Link command digest of the current executable, stored next to the dependency state
+        bool ReadLinkDigest(uint64_t& digestOut);
+        void WriteLinkDigest(uint64_t digest);
+
+        // A batch is closed once its sources usually take this long, so batches still spread over the workers
+        static constexpr float MaxBatchSeconds = 2.0f;
+
+        // The compiler runs in a scratch directory and names every object and dependency file after its
+        // source there, so paths in the arguments are made absolute and mapped back to the single compile's
+        // relative ones in the debug info and __FILE__, the objects match the recorded command digest
+        std::vector<std::string> GetBatchArguments(const std::string& batchDir, const std::vector<std::string>& sources);
+
+        // Moves the object and dependency file of a batched source to where a single compile puts them
+        bool MoveBatchOutputs(const std::string& batchDir, const std::string& source);
+    };
+
+    // Clang's driver takes the arguments of GCC's, so it compiles and links like the GCC toolchain. With
+    // SetTimeTrace() the -ftime-trace files written next to the objects are summed up after each build
+    class ToolchainClang : public ToolchainMinGW
+    {
+    public:
+        ToolchainClang() = default;
+        ~ToolchainClang() = default;
+
+        bool Compile(std::vector<std::string>& objectFiles) override;
+
+    protected:
+        std::string mName = "Clang";
+
+        void SetupCompileCommand() override;
+
+        // Number of headers and template instantiations printed, the report file has all of them
+        static constexpr size_t TimeTraceReportSize = 20;
     };
 
     class Compiler
@@ -85,7 +253,8 @@ namespace Leo
         enum class Toolchain
         {
             Dummy,
-            MinGW
+            MinGW,
+            Clang
         };
 
         void SetProjectInfo(
@@ -108,15 +277,35 @@ namespace Leo
 
         void SetActiveToolchain(Toolchain option);
         void SetCleanFlag(bool option);
+        void SetCompilerPath(std::string compilerPath);
+        void SetBuildDir(std::string buildDir);
+        void SetTarget(std::string name, TargetType type);
+        void SetChangeDetection(ChangeDetection option);
+        void SetJobCount(size_t jobCount);
+        void SetKeepGoing(bool option);
+        void SetJobPool(JobPool* jobPool);
+        void SetResourcePools(std::unordered_map<std::string, size_t> limits, std::unordered_map<std::string, std::string> sourcePools);
+        void SetCompileBatching(size_t maxBatchSize, std::unordered_map<std::string, float> smallSources);
+        void SetDirectCompile(bool option);
+        void SetToolchainProbe(const ToolchainProbe& probe);
+        void SetTimeTrace(bool option);
+
+        bool Compile(std::vector<std::string>& objectFiles);
+        bool Link(std::string outFileName, std::vector<std::string>& objectFiles);
+        bool AnalyzeIncludes(IncludeAnalysis& analysis);
+
+        std::vector<BuildHistory::SourceRecord>& GetSourceRecords();
+        std::unordered_map<std::string, std::vector<std::string>>& GetDependencies();
 
-        std::vector<std::string> Compile();
-        void Link(std::string outFileName, std::vector<std::string>& objectFiles);
+        std::string GetObjectPath(const std::string& source);
+        std::string GetBinaryPath(const std::string& outFileName);
 
     private:
         Toolchain mActiveToolchain = Toolchain::Dummy;
 
         ToolchainBase mToolchainDummy;
         ToolchainMinGW mToolchainMinGW;
+        ToolchainClang mToolchainClang;
     };
 }
 
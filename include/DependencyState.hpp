@@ -0,0 +1,92 @@
+#ifndef DEPENDENCYSTATE_H_
+#define DEPENDENCYSTATE_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <fstream>
+#include <unordered_map>
+
+#include "Fingerprint.hpp"
+
+namespace Leo
+{
+    // Dependencies of every source as of its last successful compile, with a digest of their stamps
+    // and one of the command line it was compiled with.
+    // Keeps the reverse index (file -> sources including it) so a build can start from the changed files
+    class DependencyState
+    {
+    public:
+        DependencyState() = default;
+        ~DependencyState() = default;
+        DependencyState(DependencyState&&) = default;
+        DependencyState& operator=(DependencyState&&) = default;
+
+        // Load() replays the journal next to the file, Save() folds it into the file
+        bool Load(std::string filepath);
+        bool Save(std::string filepath);
+
+        // Sources compiled during a build are appended to "<filepath>.journal" right away, each record
+        // with a checksum, so an interrupted build keeps what it finished. A torn record ends the replay
+        bool OpenJournal(std::string filepath);
+        bool AppendToJournal(const std::string& source);
+
+        // False if the source was never compiled successfully
+        bool GetSource(const std::string& source, uint64_t& digestOut, uint64_t& commandDigestOut, std::vector<std::string>& depsOut) const;
+        void SetSource(const std::string& source, uint64_t digest, uint64_t commandDigest, const std::vector<std::string>& deps);
+        void RemoveSource(const std::string& source);
+
+        // Content digests of one mode can't be compared with another
+        ChangeDetection GetChangeDetection() const;
+        void SetChangeDetection(ChangeDetection option);
+
+        // Forgets sources that are no longer part of the project
+        void RetainSources(const std::vector<std::string>& sources);
+
+        // Every source and dependency of the recorded sources
+        std::vector<std::string> GetFiles() const;
+
+        // Digests of the file's stamp and of its content (the same as the stamp one unless
+        // a token based ChangeDetection is used) when the state was saved. False if unknown
+        bool GetFileDigests(const std::string& path, uint64_t& stampDigestOut, uint64_t& contentDigestOut) const;
+        void SetFileDigests(const std::string& path, uint64_t stampDigest, uint64_t contentDigest);
+
+        // Sources that include 'path' or are 'path' themselves.
+        // Paths that don't match exactly are compared relative to the working directory
+        std::vector<std::string> GetDependents(const std::string& path) const;
+
+    private:
+        struct FileEntry
+        {
+            uint64_t stampDigest = 0;
+            uint64_t contentDigest = 0;
+        };
+
+        struct SourceEntry
+        {
+            uint64_t digest = 0;
+            uint64_t commandDigest = 0;
+            std::vector<uint32_t> deps;
+        };
+
+        ChangeDetection mChangeDetection = ChangeDetection::Timestamps;
+
+        // Paths are stored once and referenced by index
+        std::vector<std::string> mPaths;
+        std::unordered_map<std::string, uint32_t> mPathIndices;
+        std::vector<FileEntry> mFiles;
+        std::vector<std::vector<uint32_t>> mDependents;
+
+        std::unordered_map<uint32_t, SourceEntry> mSources;
+
+        std::ofstream mJournal;
+        size_t mReplayedCount = 0;
+
+        uint32_t GetPathIndex(const std::string& path);
+        bool LoadSnapshot(std::string filepath);
+        bool ReplayJournal(std::string filepath);
+        int64_t FindPathIndex(const std::string& path) const;
+    };
+}
+
+#endif // DEPENDENCYSTATE_H_
@@ -0,0 +1,59 @@
+#ifndef DIRECTCOMPILE_H_
+#define DIRECTCOMPILE_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+
+#include "Utils.hpp"
+
+namespace Leo
+{
+    // Commands the compiler driver starts for a compile (cc1plus and as for GCC), asked for once per compiler,
+    // flag set and source extension with -### and kept in the project cache. Compiles then start them directly
+    // and save the driver process. A plan is dropped as soon as the driver or one of its programs changes
+    class DirectCompileCache
+    {
+    public:
+        DirectCompileCache() = default;
+        ~DirectCompileCache() = default;
+
+        bool Load(std::string filepath);
+        bool Save(std::string filepath);
+
+        // Asks the driver how it compiles 'source' to 'objectFile' with 'arguments', unless that's known already.
+        // False if its plan can't be used, compiles with these flags then go through the driver
+        bool Prepare(const std::string& compilerPath, const std::vector<std::string>& arguments, const std::string& source,
+                     const std::string& objectFile, const std::string& dependencyFile);
+
+        // The plan of a prepared flag set filled in for another source. Intermediate files, removed by the
+        // caller afterwards, are named after 'objectFile'. Safe to call from several threads
+        bool GetCommands(const std::string& compilerPath, const std::vector<std::string>& arguments, const std::string& source,
+                         const std::string& objectFile, const std::string& dependencyFile,
+                         std::vector<std::vector<std::string>>& commandsOut, std::vector<std::string>& intermediatesOut) const;
+
+    private:
+        struct Plan
+        {
+            // Empty if the driver's plan can't be used
+            std::vector<std::vector<std::string>> commands;
+            std::vector<std::string> intermediates;
+
+            // The driver and every program it starts, with the stamps they had when it was asked
+            std::vector<std::string> programs;
+            std::vector<Utils::FileStamp> stamps;
+        };
+
+        std::unordered_map<uint64_t, Plan> mPlans;
+        std::string mProbeFile;
+
+        // Paths of one compile that differ between sources, in the order they are replaced
+        static std::vector<std::string> GetSubstitutions(const std::string& source, const std::string& objectFile,
+                                                         const std::string& dependencyFile);
+        static uint64_t GetKey(const std::string& compilerPath, const std::vector<std::string>& arguments,
+                               const std::vector<std::string>& substitutions);
+    };
+}
+
+#endif // DIRECTCOMPILE_H_
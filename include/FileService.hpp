@@ -0,0 +1,48 @@
+#ifndef FILESERVICE_H_
+#define FILESERVICE_H_
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <memory>
+
+#include "Utils.hpp"
+
+namespace Leo
+{
+    // Batched file metadata queries and reads.
+    // Uses io_uring where the kernel supports it and falls back to a pool of threads otherwise.
+    // Calls from several threads take turns on the ring
+    class FileService
+    {
+    public:
+        FileService();
+        ~FileService();
+
+        FileService(const FileService&) = delete;
+        FileService& operator=(const FileService&) = delete;
+
+        // Results are in the same order as 'paths'
+        void Stat(const std::vector<std::string>& paths, std::vector<Utils::FileStamp>& stampsOut);
+
+        // Reads whole files, 'foundOut' is false for files that could not be read
+        void Read(const std::vector<std::string>& paths, std::vector<std::string>& contentsOut, std::vector<bool>& foundOut);
+
+        bool IsUsingIoUring() const;
+
+    private:
+        struct Ring;
+        std::unique_ptr<Ring> mRing;
+        std::mutex mMutex;
+
+        // Stat() with the lock already held
+        void StatWithRing(const std::vector<std::string>& paths, std::vector<Utils::FileStamp>& stampsOut);
+
+        void ReadWithThreads(const std::vector<std::string>& paths, std::vector<std::string>& contentsOut, std::vector<bool>& foundOut);
+    };
+
+    // One per process, every toolchain and the stat cache share its ring
+    FileService& GetFileService();
+}
+
+#endif // FILESERVICE_H_
@@ -0,0 +1,26 @@
+#ifndef FINGERPRINT_H_
+#define FINGERPRINT_H_
+
+#include <string>
+#include <cstdint>
+
+namespace Leo
+{
+    // What makes a source or header count as changed, set per project with <ChangeDetection>
+    enum class ChangeDetection
+    {
+        // Any new modification time or size
+        Timestamps,
+        // Different preprocessing tokens or line numbers, comment and whitespace edits on a line are ignored
+        Tokens,
+        // Different preprocessing tokens, for code that doesn't depend on __LINE__ or debug line info
+        TokensIgnoreLines
+    };
+
+    // Hash of the preprocessing tokens of C or C++ text. Comments and whitespace don't change it
+    // unless the whitespace separates two tokens that would otherwise merge, directives keep their line ends.
+    // Single pass without allocations, about as fast as hashing the raw bytes
+    uint64_t GetTokenFingerprint(const std::string& text, bool keepLines, uint64_t seed = 14695981039346656037ull);
+}
+
+#endif // FINGERPRINT_H_
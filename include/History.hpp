@@ -0,0 +1,53 @@
+#ifndef HISTORY_H_
+#define HISTORY_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace Leo
+{
+    class BuildHistory
+    {
+    public:
+        BuildHistory() = default;
+        ~BuildHistory() = default;
+
+        // Statistics of a single translation unit within a build
+        struct SourceRecord
+        {
+            std::string source;
+            float wallSeconds = 0.0f;
+            float cpuSeconds = 0.0f;
+            uint32_t peakMemoryKB = 0;
+            uint32_t dependencyCount = 0;
+            bool cacheHit = false;
+            uint64_t flagHash = 0;
+        };
+
+        struct BuildRecord
+        {
+            int64_t timestamp = 0;
+            float wallSeconds = 0.0f;
+            std::string gitHead;
+            std::vector<SourceRecord> sources;
+        };
+
+        // Number of builds kept before the oldest ones get dropped
+        static constexpr uint32_t Capacity = 64;
+
+        bool Load(std::string filepath);
+        bool Save(std::string filepath);
+
+        void Append(BuildRecord record);
+        void DisplayReport(int buildCount);
+
+        const std::vector<BuildRecord>& GetRecords() const;
+
+    private:
+        // Oldest build first
+        std::vector<BuildRecord> mRecords;
+    };
+}
+
+#endif // HISTORY_H_
@@ -0,0 +1,58 @@
+#ifndef INCLUDEANALYSIS_H_
+#define INCLUDEANALYSIS_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <unordered_map>
+
+namespace Leo
+{
+    // What headers cost across a project, from the include trees GCC prints with -H and the phase times of
+    // -ftime-report. An #include is charged the bytes of every file first read below it and the same share
+    // of its source's parse time, which is about what the source would save without that #include
+    class IncludeAnalysis
+    {
+    public:
+        IncludeAnalysis() = default;
+        ~IncludeAnalysis() = default;
+
+        // Adds the compiler output of one source, false if it has no -ftime-report in it
+        bool AddCompileOutput(const std::string& source, const std::string& output);
+
+        size_t GetSourceCount() const;
+
+        // Prints the 'count' headers whose removal would save the most build time
+        void Display(size_t count) const;
+
+        // Every header as JSON, sorted like Display()
+        bool Save(std::string filepath) const;
+
+    private:
+        struct Cost
+        {
+            // Seconds of parsing the project would save without the header
+            double seconds = 0.0;
+
+            // Bytes read for it (itself and what it includes first), summed over the sources
+            uint64_t bytes = 0;
+
+            // Sources including it
+            uint32_t sources = 0;
+        };
+
+        std::unordered_map<std::string, Cost> mHeaders;
+        std::unordered_map<std::string, uint64_t> mFileSizes;
+        size_t mSourceCount = 0;
+        double mParseSeconds = 0.0;
+
+        uint64_t GetFileSize(const std::string& path);
+        std::vector<std::pair<std::string, Cost>> GetSorted() const;
+
+        // CPU time of the phases that parse the source, 0 if -ftime-report printed none
+        static double GetParseSeconds(const std::string& output);
+    };
+}
+
+#endif // INCLUDEANALYSIS_H_
@@ -0,0 +1,73 @@
+#ifndef JOBPOOL_H_
+#define JOBPOOL_H_
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <condition_variable>
+
+namespace Leo
+{
+    // Fixed set of worker threads running submitted jobs in order, e.g. one compiler process each.
+    // Several builds can share one pool, each keeping track of its own jobs.
+    // Jobs of a named resource (links, memory hungry compiles) run at most as many at once as its limit,
+    // queued jobs of other resources move past them meanwhile
+    class JobPool
+    {
+    public:
+        // 0 uses one worker per hardware thread
+        explicit JobPool(size_t workerCount = 0);
+        ~JobPool();
+
+        JobPool(const JobPool&) = delete;
+        JobPool& operator=(const JobPool&) = delete;
+
+        // Starts the job as soon as a worker is free and 'resource' has room, callable while other jobs run.
+        // An empty resource or one without a limit only counts against the workers
+        void Submit(std::function<void()> job, std::string resource = "");
+
+        // The lowest limit set for a resource wins, at least one job of it always runs
+        void SetResourceLimit(const std::string& resource, size_t limit);
+
+        // Blocks until every submitted job finished
+        void Wait();
+
+        // Queued jobs still run so every build sees its jobs come back,
+        // they are expected to check IsCancelled() first and return right away
+        void Cancel();
+        bool IsCancelled() const;
+
+        size_t GetWorkerCount() const;
+
+    private:
+        struct QueuedJob
+        {
+            std::function<void()> job;
+            std::string resource;
+        };
+
+        std::vector<std::thread> mWorkers;
+        std::deque<QueuedJob> mJobs;
+        std::unordered_map<std::string, size_t> mResourceLimits;
+        std::unordered_map<std::string, size_t> mResourceUsage;
+        size_t mRunningJobs = 0;
+        bool mStopping = false;
+        std::atomic<bool> mCancelled{false};
+
+        std::mutex mMutex;
+        std::condition_variable mJobAvailable;
+        std::condition_variable mJobsFinished;
+
+        void RunWorker();
+
+        // First queued job whose resource has room, mJobs.end() if none. Needs mMutex held
+        std::deque<QueuedJob>::iterator FindRunnableJob();
+    };
+}
+
+#endif // JOBPOOL_H_
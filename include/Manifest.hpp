@@ -0,0 +1,42 @@
+#ifndef MANIFEST_H_
+#define MANIFEST_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "Utils.hpp"
+
+namespace Leo
+{
+    // Every input and output of the last successful build with the stamp it had back then.
+    // Lets a build where nothing changed finish without parsing the project file
+    class BuildManifest
+    {
+    public:
+        BuildManifest() = default;
+        ~BuildManifest() = default;
+
+        bool Load(std::string filepath);
+        bool Save(std::string filepath);
+
+        // Hash of everything outside the files that affects the build (options, working directory)
+        void SetOptionsHash(uint64_t optionsHash);
+        void AddFile(std::string path);
+
+        // Stamps the added files, fails if any of them is missing
+        bool Finalize();
+
+        // True if the options match and no file changed since Finalize()
+        bool IsUpToDate(uint64_t optionsHash);
+
+        size_t GetFileCount() const;
+
+    private:
+        uint64_t mOptionsHash = 0;
+        std::vector<std::string> mPaths;
+        std::vector<Utils::FileStamp> mStamps;
+    };
+}
+
+#endif // MANIFEST_H_
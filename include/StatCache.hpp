@@ -0,0 +1,85 @@
+#ifndef STATCACHE_H_
+#define STATCACHE_H_
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+
+#include "Utils.hpp"
+#include "FileService.hpp"
+
+namespace Leo
+{
+    // Memoized file stamps for the duration of a build, so every file is stat'ed once.
+    // Paths are interned into small ids, the table is sharded so threads rarely contend
+    class StatCache
+    {
+    public:
+        StatCache() = default;
+        ~StatCache() = default;
+
+        using PathId = uint32_t;
+
+        PathId Intern(const std::string& path);
+        std::string GetPath(PathId id);
+
+        Utils::FileStamp Get(PathId id);
+        Utils::FileStamp Get(const std::string& path);
+
+        // Hash of the path and its stamp, computed once per stat
+        uint64_t GetDigest(PathId id);
+
+        // Stats every id not cached yet in one batch
+        void Prefetch(const std::vector<PathId>& ids);
+
+        // Call after writing a file so the next query sees the new stamp
+        void Invalidate(const std::string& path);
+
+        uint64_t GetHitCount() const;
+        uint64_t GetMissCount() const;
+
+    private:
+        static constexpr uint32_t ShardBits = 4;
+        static constexpr uint32_t ShardCount = 1 << ShardBits;
+
+        enum class EntryState
+        {
+            Unknown,
+            // Being stat'ed by Prefetch()
+            Pending,
+            Valid
+        };
+
+        struct Entry
+        {
+            Utils::FileStamp stamp;
+            uint64_t digest = 0;
+            EntryState state = EntryState::Unknown;
+        };
+
+        // Deques keep references stable while other threads intern new paths
+        struct Shard
+        {
+            std::mutex mutex;
+            std::unordered_map<std::string, uint32_t> indices;
+            std::deque<std::string> paths;
+            std::deque<Entry> entries;
+        };
+
+        Shard mShards[ShardCount];
+
+        static uint64_t MakeDigest(const std::string& path, const Utils::FileStamp& stamp);
+
+        std::atomic<uint64_t> mHits{0};
+        std::atomic<uint64_t> mMisses{0};
+    };
+
+    // Shared by everything that looks at file stamps during a build
+    StatCache& GetStatCache();
+}
+
+#endif // STATCACHE_H_
@@ -0,0 +1,52 @@
+#ifndef SYSTEMHEADERS_H_
+#define SYSTEMHEADERS_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+
+#include "ToolchainProbe.hpp"
+
+namespace Leo
+{
+    // System headers included by the sources of a project, checked as one unit instead of per source.
+    // They only change with the toolchain or the installed packages, so while a fingerprint of those
+    // stays the same none of them is looked at. Otherwise every recorded header is compared once
+    class SystemHeaderState
+    {
+    public:
+        SystemHeaderState() = default;
+        ~SystemHeaderState() = default;
+
+        bool Load(std::string filepath);
+        bool Save(std::string filepath);
+
+        // Identity of the toolchain combined with the stamps of GetWatchedPaths()
+        static uint64_t GetFingerprint(const ToolchainProbe& probe);
+
+        // The compiler, its system include directories and the package manager databases that exist,
+        // any of them changes when system headers are installed, removed or updated
+        static std::vector<std::string> GetWatchedPaths(const ToolchainProbe& probe);
+
+        // Fingerprint the recorded headers were last checked with
+        uint64_t GetLastFingerprint() const;
+        void SetLastFingerprint(uint64_t fingerprint);
+
+        // True if every recorded header still has the stamp it was recorded with
+        bool Recheck() const;
+
+        // Records headers not known yet with their current stamps
+        void AddHeaders(const std::vector<std::string>& headers);
+
+        size_t GetHeaderCount() const;
+
+    private:
+        uint64_t mLastFingerprint = 0;
+
+        // Stamp digest of every header
+        std::unordered_map<std::string, uint64_t> mHeaders;
+    };
+}
+
+#endif // SYSTEMHEADERS_H_
@@ -0,0 +1,48 @@
+#ifndef TIMETRACE_H_
+#define TIMETRACE_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <unordered_map>
+
+namespace Leo
+{
+    // Sums the -ftime-trace files Clang writes for every translation unit up. A header is charged the
+    // whole time spent in it, including the headers it includes, so headers pulling in much rank high
+    class TimeTraceReport
+    {
+    public:
+        TimeTraceReport() = default;
+        ~TimeTraceReport() = default;
+
+        // Adds the trace of one translation unit, false if it is missing or malformed
+        bool AddTrace(const std::string& filepath);
+
+        size_t GetTraceCount() const;
+
+        // Prints the 'count' most expensive headers and template instantiations
+        void Display(size_t count) const;
+
+        // Every header and template instantiation as JSON, the most expensive first
+        bool Save(std::string filepath) const;
+
+    private:
+        struct Cost
+        {
+            double seconds = 0.0;
+
+            // Translation units paying for it
+            uint32_t sources = 0;
+        };
+
+        std::unordered_map<std::string, Cost> mHeaders;
+        std::unordered_map<std::string, Cost> mInstantiations;
+        size_t mTraceCount = 0;
+
+        static std::vector<std::pair<std::string, Cost>> GetSorted(const std::unordered_map<std::string, Cost>& costs);
+    };
+}
+
+#endif // TIMETRACE_H_
@@ -0,0 +1,69 @@
+#ifndef TOOLCHAINPROBE_H_
+#define TOOLCHAINPROBE_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "Utils.hpp"
+
+namespace Leo
+{
+    // What the compiler reports about itself: its version, the machine it compiles for and the directories
+    // it searches for system headers. Asked once with --version, -dumpmachine and -E -v and kept in the
+    // project cache, until the compiler's file gets another path, modification time or size
+    class ToolchainProbe
+    {
+    public:
+        ToolchainProbe() = default;
+        ~ToolchainProbe() = default;
+
+        // Loads the answers of the last probe from 'filepath' or asks 'compilerPath' again if they are stale.
+        // False if the compiler can't be found or fails to answer
+        bool Probe(const std::string& compilerPath, const std::string& filepath);
+
+        // Path of the compiler's file, with symlinks resolved
+        const std::string& GetCompilerFile() const;
+
+        // First line of --version, e.g. "g++ (GCC) 13.2.0"
+        const std::string& GetVersion() const;
+
+        // Target triple from -dumpmachine, e.g. "x86_64-linux-gnu"
+        const std::string& GetMachine() const;
+
+        // Directories of #include <...> beyond those of the project, in search order
+        const std::vector<std::string>& GetSystemIncludeDirs() const;
+
+        // True if the version names Clang, which also answers to g++ on macOS
+        bool IsClang() const;
+
+        // Changes whenever another compiler version or target would produce different objects
+        uint64_t GetIdentity() const;
+
+        // True if the header is in one of the system include directories
+        bool IsSystemHeader(const std::string& path) const;
+
+        // Outputs follow Windows conventions (.dll, no -fPIC or rpath). The host decides if probing failed
+        bool TargetsWindows() const;
+
+        // ar of the target's binutils ("<machine>-ar") if installed, cross compilers need it. Plain ar otherwise
+        std::string GetArchiverPath() const;
+
+    private:
+        std::string mCompilerFile;
+        Utils::FileStamp mCompilerStamp;
+
+        std::string mVersion;
+        std::string mMachine;
+        std::vector<std::string> mSystemIncludeDirs;
+
+        bool Load(const std::string& filepath);
+        bool Save(const std::string& filepath);
+
+        // Runs the compiler with its output going to 'outputFile' and returns that output
+        static bool ReadOutput(const std::string& compilerPath, const std::vector<std::string>& arguments,
+                               const std::string& outputFile, std::string& outputOut);
+    };
+}
+
+#endif // TOOLCHAINPROBE_H_
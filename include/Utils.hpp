@@ -7,11 +7,150 @@
 #include <fstream>
 #include <filesystem>
 #include <chrono>
+#include <cstdint>
+#include <atomic>
 
 namespace Utils
 {
-    void StartProcessAndWait(std::string program, const std::vector<std::string>& args);
+    // Process wide counters of the expensive operations, reported by --stats and --verbose
+    struct Counters
+    {
+        std::atomic<uint64_t> processSpawns{0};
+        std::atomic<uint64_t> statCalls{0};
+    };
+
+    Counters& GetCounters();
+
+    // Writes the counters as a flat JSON object
+    bool WriteCounters(std::string filepath);
+
+    // Resource usage of a finished child process
+    struct ProcessStats
+    {
+        double wallSeconds = 0.0;
+        double cpuSeconds = 0.0;
+        uint64_t peakMemoryKB = 0;
+    };
+
+    // Returns the exit code of the program, 128 + signal number if it was killed and -1 if it couldn't be started.
+    // The program runs in 'workingDir' and writes stdout and stderr to 'outputFile' if they're given
+    int StartProcessAndWait(std::string program, const std::vector<std::string>& args, ProcessStats* stats = nullptr,
+                            const std::string& workingDir = "", const std::string& outputFile = "");
+
+    // Stops every program started by StartProcessAndWait() that is still running, from any thread
+    void TerminateRunningProcesses();
+
+    // Modification time (nanoseconds since epoch) and size of a file
+    struct FileStamp
+    {
+        int64_t modifiedTime = 0;
+        uint64_t size = 0;
+        bool exists = false;
+
+        bool operator==(const FileStamp& other) const
+        {
+            return modifiedTime == other.modifiedTime && size == other.size && exists == other.exists;
+        }
+
+        bool operator!=(const FileStamp& other) const
+        {
+            return !(*this == other);
+        }
+    };
+
+    FileStamp GetFileStamp(const std::string& path);
+
+    // Stats all paths, spread over several threads when there are many of them
+    void GetFileStamps(const std::vector<std::string>& paths, std::vector<FileStamp>& stampsOut);
+
+    // Returns the commit hash HEAD points to, or an empty string outside of a git repository
+    std::string GetGitHead(std::string rootDir);
+
+    // Path of the file a program name is started from, searched in PATH unless it contains a directory.
+    // Empty if it can't be found
+    std::string FindProgram(const std::string& program);
+
+    // 64-bit FNV-1a, pass the previous result as 'seed' to hash several strings together
+    inline uint64_t HashString(const std::string& text, uint64_t seed = 14695981039346656037ull)
+    {
+        uint64_t hash = seed;
+        for(unsigned char c : text)
+        {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Same as HashString() for the 8 bytes of 'value'
+    inline uint64_t HashValue(uint64_t value, uint64_t seed = 14695981039346656037ull)
+    {
+        uint64_t hash = seed;
+        for(int i = 0; i < 8; i++)
+        {
+            hash ^= (value >> (i * 8)) & 0xff;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
     
+    // Raw binary serialization helpers for the files in the project cache
+    template<typename T>
+    inline void WriteBinary(std::ostream& out, const T& value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    inline void WriteBinary(std::ostream& out, const std::string& value)
+    {
+        uint32_t length = static_cast<uint32_t>(value.length());
+        WriteBinary(out, length);
+        out.write(value.data(), length);
+    }
+
+    template<typename T>
+    inline bool ReadBinary(std::istream& in, T& value)
+    {
+        in.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return static_cast<bool>(in);
+    }
+
+    inline bool ReadBinary(std::istream& in, std::string& value)
+    {
+        // Strings are paths, commands and names, a longer one means the file is corrupt
+        const uint32_t maxLength = 16 << 20;
+        uint32_t length = 0;
+        if(!ReadBinary(in, length))
+            return false;
+
+        if(length > maxLength)
+        {
+            in.setstate(std::ios::failbit);
+            return false;
+        }
+
+        value.resize(length);
+        in.read(value.data(), length);
+        return static_cast<bool>(in);
+    }
+
+    // Text as the contents of a JSON string, control characters become spaces
+    inline std::string EscapeJson(const std::string& text)
+    {
+        std::string result;
+        for(char c : text)
+        {
+            if(c == '"' || c == '\\')
+                result += '\\';
+
+            if(static_cast<unsigned char>(c) < 0x20)
+                result += ' ';
+            else
+                result += c;
+        }
+        return result;
+    }
+
     inline std::string NormalizePath(std::string text)
     {
         // Change backslash to forward slash
@@ -46,18 +185,21 @@ namespace Utils
 
     inline bool PathExists(std::string path)
     {
+        GetCounters().statCalls++;
         return std::filesystem::exists(path);
     }
 
+    // Missing parent directories are created as well
     inline bool CreateDirectory(std::string path)
     {
-        return std::filesystem::create_directory(path);
+        return std::filesystem::create_directories(path);
     }
 
     inline std::filesystem::file_time_type GetFileModifiedTime(std::string path)
     {
         // It is slower than platform specific methods
         // We are trading speed with portability
+        GetCounters().statCalls++;
         return std::filesystem::last_write_time(path);
     }
 
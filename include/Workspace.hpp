@@ -0,0 +1,55 @@
+#ifndef WORKSPACE_H_
+#define WORKSPACE_H_
+
+#include <vector>
+#include <string>
+#include <memory>
+
+#include "BuildSystem.hpp"
+
+namespace Leo
+{
+    // Several projects built in one run. The project files are read in parallel, every project compiles
+    // on one shared job pool and links only wait for the projects they list in <Dependencies>
+    class Workspace
+    {
+    public:
+        // Every project is built with the options set on 'settings', into its own
+        // "<buildDir>/<project file name>" so projects sharing a directory don't clash
+        Workspace(const BuildSystem& settings, std::string buildDir, size_t jobCount);
+        ~Workspace() = default;
+
+        // True if the file's root element is <Workspace>
+        static bool IsWorkspaceFile(const std::string& filepath);
+
+        // A project file, or a <Workspace> file listing <Project> paths relative to itself
+        bool AddFile(std::string filepath);
+
+        // False if a project failed to load or build
+        bool Build();
+
+    private:
+        BuildSystem mSettings;
+        std::vector<std::string> mProjectFiles;
+        std::string mBuildDir;
+        size_t mJobCount = 0;
+
+        // Workspace files AddFile() is reading, a nested one among them would never finish
+        std::vector<std::string> mExpandingFiles;
+
+        struct Project
+        {
+            std::string file;
+            std::unique_ptr<BuildSystem> buildSystem;
+            bool upToDate = false;
+            std::vector<size_t> dependencies;
+        };
+
+        // Adds the <Project> entries of a workspace file
+        bool AddWorkspaceProjects(const std::string& filepath);
+
+        bool LoadProjects(std::vector<Project>& projectsOut);
+    };
+}
+
+#endif // WORKSPACE_H_
@@ -1,17 +1,66 @@
 #include "BuildSystem.hpp"
 #include "Compilers.hpp"
+#include "DependencyState.hpp"
+#include "History.hpp"
+#include "IncludeAnalysis.hpp"
+#include "JobPool.hpp"
+#include "Manifest.hpp"
+#include "StatCache.hpp"
+#include "ToolchainProbe.hpp"
 #include "ext/tinyxml2/tinyxml2.h"
 #include "Utils.hpp"
+
+#include <ctime>
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <memory>
+#include <set>
+#include <thread>
 using namespace tinyxml2;
 
+// Replaces 'itemsOut' with the items of the list, false if 'parent' has no such list
+static bool ReadItems(XMLElement* parent, const char* name, std::vector<std::string>& itemsOut)
+{
+    XMLElement* list = (parent != nullptr) ? parent->FirstChildElement(name) : nullptr;
+    if(list == nullptr)
+        return false;
+
+    itemsOut.clear();
+    for(XMLElement* item = list->FirstChildElement("Item"); item != nullptr; item = item->NextSiblingElement("Item"))
+    {
+        if(item->GetText() != nullptr)
+            itemsOut.push_back(item->GetText());
+    }
+    return true;
+}
+
+// The latest compile of every source recorded in the history, builds finding a source up to date record none
+static std::unordered_map<std::string, Leo::BuildHistory::SourceRecord> GetLatestCompiles(const std::string& historyFile)
+{
+    std::unordered_map<std::string, Leo::BuildHistory::SourceRecord> compiles;
+    Leo::BuildHistory history;
+    history.Load(historyFile);
+    for(const Leo::BuildHistory::BuildRecord& build : history.GetRecords())
+    {
+        for(const Leo::BuildHistory::SourceRecord& source : build.sources)
+        {
+            if(!source.cacheHit)
+                compiles[source.source] = source;
+        }
+    }
+    return compiles;
+}
+
 namespace Leo
 {
     bool BuildSystem::ReadProjectFile(std::string filepath)
     {
         if(mVerbosityLevel == VerbosityLevel::Extended)
             std::cout << "Loading project: " << Utils::GetAbsolutePath(filepath) << "\n";
+        mProjectFile = Utils::GetAbsolutePath(filepath);
         mProjectRootDir = Utils::StripFilePath(Utils::GetAbsolutePath(filepath));
-        mProjectCacheDir = mProjectRootDir + "/LeoProjectCache";
+        mProjectCacheDir = GetCacheDir(filepath, (mConfigurationName == "all") ? "" : mConfigurationName);
 
         if(mVerbosityLevel == VerbosityLevel::Extended)
         {
@@ -57,9 +106,6 @@ namespace Leo
             } while((item = item->NextSiblingElement()) != nullptr);
         }
 
-        if(mSourceFiles.empty())
-            std::cout << "ERROR: BuildSystem: No source files provided\n";
-
         headers = project->FirstChildElement("Headers");
         item = headers->FirstChildElement("Item");
         if(item != nullptr)
@@ -156,42 +202,643 @@ namespace Leo
             }
         }
 
+        // Optional, what counts as a change of a source or header
+        XMLElement* changeDetection = project->FirstChildElement("ChangeDetection");
+        if(changeDetection != nullptr && changeDetection->GetText() != nullptr)
+        {
+            std::string text = changeDetection->GetText();
+            if(text == "Timestamps")
+                mChangeDetection = ChangeDetection::Timestamps;
+            else if(text == "Tokens")
+                mChangeDetection = ChangeDetection::Tokens;
+            else if(text == "TokensIgnoreLines")
+                mChangeDetection = ChangeDetection::TokensIgnoreLines;
+            else
+                std::cout << "WARNING: BuildSystem: Unknown ChangeDetection '" << text << "'. Using 'Timestamps'\n";
+        }
+
+        // Optional, every list a configuration has replaces the project's one, the rest is inherited
+        for(XMLElement* element = project->FirstChildElement("Configuration"); element != nullptr;
+            element = element->NextSiblingElement("Configuration"))
+        {
+            const char* name = element->Attribute("Name");
+            if(name == nullptr || std::string(name).empty() || std::string(name) == "all")
+            {
+                std::cout << "WARNING: BuildSystem: Skipping a configuration without a usable name\n";
+                continue;
+            }
+
+            Configuration configuration = { name, mCompilerFlags, mCompilerDefines, mCompilerIncludeDirectories,
+                                            mLinkerFlags, mLinkerLibraries, mLinkerIncludeDirectories };
+
+            XMLElement* compilerOptions = element->FirstChildElement("CompilerOptions");
+            ReadItems(compilerOptions, "Flags", configuration.compilerFlags);
+            ReadItems(compilerOptions, "Defines", configuration.compilerDefines);
+            ReadItems(compilerOptions, "Include", configuration.compilerIncludeDirectories);
+
+            XMLElement* linkerOptions = element->FirstChildElement("LinkerOptions");
+            ReadItems(linkerOptions, "Flags", configuration.linkerFlags);
+            ReadItems(linkerOptions, "Libraries", configuration.linkerLibraries);
+            ReadItems(linkerOptions, "Include", configuration.linkerIncludeDirectories);
+
+            mConfigurations.push_back(configuration);
+        }
+
+        if(!mConfigurationName.empty())
+        {
+            bool found = std::any_of(mConfigurations.begin(), mConfigurations.end(), [this](const Configuration& configuration) {
+                return mConfigurationName == "all" || configuration.name == mConfigurationName;
+            });
+
+            if(!found)
+            {
+                std::cout << "ERROR: BuildSystem: No configuration named '" << mConfigurationName << "'\n";
+                return false;
+            }
+        }
+
+        // Optional, without targets the project's sources make up one executable
+        std::vector<std::vector<std::string>> dependencyNames;
+        for(XMLElement* element = project->FirstChildElement("Target"); element != nullptr;
+            element = element->NextSiblingElement("Target"))
+        {
+            Target target;
+            const char* name = element->Attribute("Name");
+            const char* type = element->Attribute("Type");
+            target.name = (name != nullptr) ? name : "";
+            std::string typeName = (type != nullptr) ? type : "Executable";
+
+            if(target.name.empty() || target.name.find_first_of("/\\") != std::string::npos)
+            {
+                std::cout << "ERROR: BuildSystem: A target needs a 'Name' usable as a file name\n";
+                return false;
+            }
+
+            if(std::any_of(mTargets.begin(), mTargets.end(), [&target](const Target& other) { return other.name == target.name; }))
+            {
+                std::cout << "ERROR: BuildSystem: Duplicate target '" << target.name << "'\n";
+                return false;
+            }
+
+            if(typeName == "Executable")
+                target.type = TargetType::Executable;
+            else if(typeName == "StaticLibrary")
+                target.type = TargetType::StaticLibrary;
+            else if(typeName == "SharedLibrary")
+                target.type = TargetType::SharedLibrary;
+            else
+            {
+                std::cout << "ERROR: BuildSystem: Unknown type '" << typeName << "' of target '" << target.name << "'\n";
+                return false;
+            }
+
+            ReadItems(element, "Sources", target.sources);
+            if(target.sources.empty())
+            {
+                std::cout << "ERROR: BuildSystem: No source files provided for target '" << target.name << "'\n";
+                return false;
+            }
+
+            dependencyNames.emplace_back();
+            ReadItems(element, "Dependencies", dependencyNames.back());
+            mTargets.push_back(target);
+        }
+
+        for(size_t i = 0; i < mTargets.size(); i++)
+        {
+            for(const std::string& dependencyName : dependencyNames[i])
+            {
+                auto dependency = std::find_if(mTargets.begin(), mTargets.end(), [&dependencyName](const Target& target) {
+                    return target.name == dependencyName;
+                });
+
+                if(dependency == mTargets.end() || dependency->type == TargetType::Executable)
+                {
+                    std::cout << "ERROR: BuildSystem: Target '" << mTargets[i].name << "' depends on '" << dependencyName
+                              << "', which is not a library target\n";
+                    return false;
+                }
+                mTargets[i].dependencies.push_back(static_cast<size_t>(dependency - mTargets.begin()));
+            }
+        }
+
+        // A link waits for the ones of its dependencies, a cycle would never finish
+        std::vector<int> visitState(mTargets.size(), 0);
+        std::function<bool(size_t)> isAcyclic = [&](size_t index) {
+            if(visitState[index] != 0)
+                return visitState[index] == 2;
+
+            visitState[index] = 1;
+            for(size_t dependency : mTargets[index].dependencies)
+            {
+                if(!isAcyclic(dependency))
+                    return false;
+            }
+            visitState[index] = 2;
+            return true;
+        };
+
+        for(size_t i = 0; i < mTargets.size(); i++)
+        {
+            if(!isAcyclic(i))
+            {
+                std::cout << "ERROR: BuildSystem: Target '" << mTargets[i].name << "' is part of a dependency cycle\n";
+                return false;
+            }
+        }
+
+        // Optional, projects of the same workspace this one links against
+        ReadItems(project, "Dependencies", mProjectDependencyNames);
+
+        // Optional, caps on how many links or memory hungry compiles run at once
+        XMLElement* resourcePools = project->FirstChildElement("ResourcePools");
+        for(XMLElement* element = (resourcePools != nullptr) ? resourcePools->FirstChildElement("Pool") : nullptr;
+            element != nullptr; element = element->NextSiblingElement("Pool"))
+        {
+            const char* name = element->Attribute("Name");
+            int depth = element->IntAttribute("Depth", 0);
+            if(name == nullptr || std::string(name).empty() || depth < 1)
+            {
+                std::cout << "WARNING: BuildSystem: Skipping a resource pool without a name or a positive 'Depth'\n";
+                continue;
+            }
+
+            ResourcePool pool;
+            pool.name = name;
+            pool.depth = static_cast<size_t>(depth);
+            pool.minMemoryKB = element->UnsignedAttribute("MinMemoryMB", 0) * 1024;
+            for(XMLElement* item = element->FirstChildElement("Item"); item != nullptr; item = item->NextSiblingElement("Item"))
+            {
+                if(item->GetText() != nullptr)
+                    pool.sources.push_back(item->GetText());
+            }
+            mResourcePools.push_back(pool);
+        }
+
+        if(mTargets.empty() && mSourceFiles.empty())
+            std::cout << "ERROR: BuildSystem: No source files provided\n";
+        if(!mTargets.empty() && !mSourceFiles.empty())
+            std::cout << "WARNING: BuildSystem: Project sources outside of a <Target> are not built\n";
+
         return true;
     }
 
-    void BuildSystem::StartBuild()
+    bool BuildSystem::IsUpToDate(std::string filepath)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        // Configuration names are only known from the project file. Reports are printed by a build
+        if(mConfigurationName == "all" || mAnalyzeIncludes || mTimeTrace)
+            return false;
+
+        std::string cacheDir = GetCacheDir(filepath, mConfigurationName);
 
+        BuildManifest manifest;
+        if(!manifest.Load(cacheDir + "/manifest"))
+            return false;
+
+        bool upToDate = manifest.IsUpToDate(GetOptionsHash(mConfigurationName));
+        if(mVerbosityLevel == VerbosityLevel::Extended)
+        {
+            std::cout << "Checked " << manifest.GetFileCount() << " files of the last build in "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count() << " ms\n";
+        }
+
+        return upToDate;
+    }
+
+    bool BuildSystem::StartBuild(JobPool* jobPool)
     {
         DisplayBuildInfo();
-        Compiler compiler;
-        compiler.SetActiveToolchain(Compiler::Toolchain::MinGW);
-        compiler.SetCleanFlag(false);
 
-        // Setup project cache
-        if(!Utils::PathExists(mProjectCacheDir))
+        std::vector<Configuration> configurations;
+        if(mConfigurationName.empty())
         {
-            Utils::CreateDirectory(mProjectCacheDir);
+            configurations.push_back({ "", mCompilerFlags, mCompilerDefines, mCompilerIncludeDirectories,
+                                       mLinkerFlags, mLinkerLibraries, mLinkerIncludeDirectories });
+        }
 
-            // Create reference point
-            std::ofstream referenceFile(mProjectCacheDir + "/reference");
-            referenceFile << "\n";
-            referenceFile.close();
+        for(const Configuration& configuration : mConfigurations)
+        {
+            if(mConfigurationName == "all" || configuration.name == mConfigurationName)
+                configurations.push_back(configuration);
+        }
+
+        for(const Configuration& configuration : configurations)
+            mLibraryOutputs[configuration.name].clear();
 
-            compiler.SetCleanFlag(true);
+        // Configurations build side by side and share the workers, the run takes about as long as the slowest one
+        bool success = true;
+        if(configurations.size() == 1)
+        {
+            success = Build(configurations[0], jobPool);
         }
+        else
+        {
+            std::unique_ptr<JobPool> ownJobPool;
+            if(jobPool == nullptr)
+            {
+                ownJobPool = std::make_unique<JobPool>(mJobCount);
+                jobPool = ownJobPool.get();
+            }
 
+            std::vector<char> results(configurations.size(), 0);
+            std::vector<std::thread> builds;
+            for(size_t i = 0; i < configurations.size(); i++)
+                builds.emplace_back([&, i]() { results[i] = Build(configurations[i], jobPool); });
 
-        compiler.SetProjectInfo(mProjectRootDir, mProjectCacheDir);
-        compiler.SetSources(mSourceFiles, mHeaderFiles);
-        compiler.SetCompilerOptions(mCompilerFlags, mCompilerDefines, mCompilerIncludeDirectories);
-        compiler.SetLinkerOptions(mLinkerFlags, mLinkerLibraries, mLinkerIncludeDirectories);
-        std::vector<std::string> objects = compiler.Compile();
-        compiler.Link(mProjectName, objects);
-        
-        // Update reference point
-        std::ofstream referenceFile(mProjectCacheDir + "/reference");
-        referenceFile << "\n";
-        referenceFile.close();
+            for(std::thread& build : builds)
+                build.join();
+
+            for(size_t i = 0; i < configurations.size(); i++)
+            {
+                std::cout << "Configuration " << configurations[i].name << ": " << (results[i] ? "succeeded" : "failed") << "\n";
+                success = success && results[i];
+            }
+        }
+
+        if(mVerbosityLevel == VerbosityLevel::Extended)
+        {
+            std::cout << "Processes started: " << Utils::GetCounters().processSpawns << "\n";
+            std::cout << "File stat calls: " << Utils::GetCounters().statCalls
+                      << " (stat cache: " << GetStatCache().GetHitCount() << " hits, "
+                      << GetStatCache().GetMissCount() << " misses)\n";
+        }
+
+        return success;
+    }
+
+    bool BuildSystem::Build(Configuration configuration, JobPool* jobPool)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        std::string buildDir = GetBuildDir(configuration.name);
+        std::string cacheDir = GetCacheDir(mProjectFile, configuration.name);
+        if(!configuration.name.empty())
+            std::cout << ("Building configuration " + configuration.name + " in " + buildDir + "\n");
+
+        // Any change from here on invalidates the last build
+        std::filesystem::remove(cacheDir + "/manifest");
+        bool cleanBuild = false;
+        if(!Utils::PathExists(cacheDir))
+        {
+            Utils::CreateDirectory(cacheDir);
+            cleanBuild = true;
+        }
+
+        // Without <Target> entries the project is a single executable named after it, with the old layout
+        std::vector<Target> targets = mTargets;
+        if(targets.empty())
+            targets.push_back({ "", TargetType::Executable, mSourceFiles, {} });
+
+        // Targets share the workers, so a library's objects compile alongside those of its dependents
+        std::unique_ptr<JobPool> ownJobPool;
+        if(jobPool == nullptr && targets.size() > 1)
+        {
+            ownJobPool = std::make_unique<JobPool>(mJobCount);
+            jobPool = ownJobPool.get();
+        }
+
+        std::unordered_map<std::string, size_t> resourceLimits;
+        std::unordered_map<std::string, std::string> sourcePools;
+        GetResourcePools(cacheDir, resourceLimits, sourcePools);
+
+        // Driver startup is a large share of short compiles, those are worth batching. Sources never
+        // compiled before are left alone until their time is known
+        std::unordered_map<std::string, float> smallSources;
+        if(mBatchSize > 1)
+        {
+            for(const auto& [source, compile] : GetLatestCompiles(cacheDir + "/history"))
+            {
+                if(compile.wallSeconds < SmallSourceSeconds)
+                    smallSources[source] = compile.wallSeconds;
+            }
+        }
+
+        // Every target compiles with the same compiler, it is asked about itself once per configuration
+        ToolchainProbe toolchainProbe;
+        if(toolchainProbe.Probe(mCompilerPath.empty() ? "g++" : mCompilerPath, cacheDir + "/toolchain")
+           && mVerbosityLevel == VerbosityLevel::Extended)
+        {
+            std::cout << ("Toolchain: " + toolchainProbe.GetVersion() + " for " + toolchainProbe.GetMachine() + ", "
+                          + std::to_string(toolchainProbe.GetSystemIncludeDirs().size()) + " system include directories\n");
+        }
+
+        // Clang takes GCC's arguments, it only gets its own toolchain for what GCC lacks
+        Compiler::Toolchain toolchain = toolchainProbe.IsClang() ? Compiler::Toolchain::Clang : Compiler::Toolchain::MinGW;
+        if(mTimeTrace && toolchain != Compiler::Toolchain::Clang)
+            std::cout << "WARNING: BuildSystem: --time-trace needs Clang, " << (mCompilerPath.empty() ? "g++" : mCompilerPath) << " isn't\n";
+
+        std::vector<std::unique_ptr<Compiler>> compilers;
+        for(Target& target : targets)
+        {
+            std::unique_ptr<Compiler> compiler = std::make_unique<Compiler>();
+            compiler->SetActiveToolchain(toolchain);
+            compiler->SetCleanFlag(cleanBuild);
+            if(!mCompilerPath.empty())
+                compiler->SetCompilerPath(mCompilerPath);
+            if(!buildDir.empty())
+                compiler->SetBuildDir(buildDir);
+            compiler->SetChangeDetection(mChangeDetection);
+            compiler->SetJobCount(mJobCount);
+            compiler->SetKeepGoing(mKeepGoing);
+            compiler->SetJobPool(jobPool);
+            compiler->SetResourcePools(resourceLimits, sourcePools);
+            compiler->SetCompileBatching(mBatchSize, smallSources);
+            compiler->SetDirectCompile(mDirectCompile);
+            compiler->SetToolchainProbe(toolchainProbe);
+            compiler->SetTimeTrace(mTimeTrace);
+
+            // Every target keeps its own dependency state and link digest
+            std::string targetCacheDir = cacheDir;
+            if(!target.name.empty())
+            {
+                compiler->SetTarget(target.name, target.type);
+                targetCacheDir += "/" + target.name;
+                if(!Utils::PathExists(targetCacheDir))
+                {
+                    Utils::CreateDirectory(targetCacheDir);
+                    compiler->SetCleanFlag(true);
+                }
+            }
+
+            compiler->SetProjectInfo(mProjectRootDir, targetCacheDir);
+            compiler->SetSources(target.sources, mHeaderFiles);
+            compiler->SetCompilerOptions(configuration.compilerFlags, configuration.compilerDefines, configuration.compilerIncludeDirectories);
+            compiler->SetLinkerOptions(configuration.linkerFlags, configuration.linkerLibraries, configuration.linkerIncludeDirectories);
+            compilers.push_back(std::move(compiler));
+        }
+
+        // Projects linking against this one need the names the probed target gives its libraries
+        if(!mTargets.empty())
+        {
+            std::vector<std::string>& libraryOutputs = mLibraryOutputs.at(configuration.name);
+            for(size_t index : GetLibraryOrder())
+                libraryOutputs.push_back(compilers[index]->GetBinaryPath(targets[index].name));
+        }
+
+        // Sources are only parsed, no object, link or dependency state is touched
+        if(mAnalyzeIncludes)
+        {
+            if(toolchain != Compiler::Toolchain::MinGW)
+            {
+                std::cout << "ERROR: BuildSystem: --analyze-includes reads GCC's -ftime-report, use --time-trace with Clang\n";
+                return false;
+            }
+
+            IncludeAnalysis analysis;
+            bool success = true;
+            for(std::unique_ptr<Compiler>& compiler : compilers)
+                success = compiler->AnalyzeIncludes(analysis) && success;
+
+            analysis.Display(IncludeReportSize);
+            if(analysis.Save(cacheDir + "/includes.json"))
+                std::cout << "Full report saved to " << cacheDir << "/includes.json\n";
+            return success;
+        }
+
+        // Only link steps are ordered, each one waits for the links of the libraries it uses
+        std::vector<std::promise<bool>> linked(targets.size());
+        std::vector<std::shared_future<bool>> linkResults;
+        for(std::promise<bool>& promise : linked)
+            linkResults.push_back(promise.get_future().share());
+
+        std::vector<std::vector<std::string>> linkedLibraries(targets.size());
+        auto buildTarget = [&](size_t index) {
+            Compiler& compiler = *compilers[index];
+            const Target& target = targets[index];
+            std::string outputName = target.name.empty() ? mProjectName : target.name;
+
+            std::vector<std::string> objects;
+            bool success = compiler.Compile(objects);
+            if(!success)
+                std::cout << (target.name.empty() ? std::string("Skipping link, the build failed\n") : "Skipping link of " + outputName + ", the build failed\n");
+
+            // An archive holds only its own objects, the final link pulls in what it depends on
+            std::vector<std::string> inputs = objects;
+            if(success && target.type != TargetType::StaticLibrary && !mTargets.empty())
+            {
+                for(size_t dependency : GetLinkOrder(index))
+                {
+                    if(!linkResults[dependency].get())
+                    {
+                        std::cout << ("Skipping link of " + outputName + ", target " + targets[dependency].name + " failed\n");
+                        success = false;
+                        break;
+                    }
+                    inputs.push_back(compilers[dependency]->GetBinaryPath(targets[dependency].name));
+                }
+            }
+
+            // Libraries of other projects come last, they can't depend on this one
+            if(success && target.type != TargetType::StaticLibrary)
+            {
+                for(const ProjectDependency& dependency : mProjectDependencies)
+                {
+                    if(!dependency.built.get())
+                    {
+                        std::cout << ("Skipping link of " + outputName + ", project " + dependency.project->GetProjectName() + " failed\n");
+                        success = false;
+                        break;
+                    }
+
+                    std::vector<std::string> libraries = dependency.project->GetLibraryOutputs(configuration.name);
+                    inputs.insert(inputs.end(), libraries.begin(), libraries.end());
+                }
+                linkedLibraries[index].assign(inputs.begin() + objects.size(), inputs.end());
+            }
+
+            // Stale objects of failed sources must not end up in the output.
+            // On a shared pool links are jobs of the "link" resource, so a <Pool> of that name limits them
+            if(success && jobPool != nullptr)
+            {
+                std::promise<bool> result;
+                jobPool->Submit([&]() { result.set_value(!jobPool->IsCancelled() && compiler.Link(outputName, inputs)); }, "link");
+                success = result.get_future().get();
+            }
+            else if(success)
+            {
+                success = compiler.Link(outputName, inputs);
+            }
+
+            linked[index].set_value(success);
+        };
+
+        if(targets.size() == 1)
+        {
+            buildTarget(0);
+        }
+        else
+        {
+            std::vector<std::thread> threads;
+            for(size_t i = 0; i < targets.size(); i++)
+                threads.emplace_back(buildTarget, i);
+
+            for(std::thread& thread : threads)
+                thread.join();
+        }
+
+        bool success = std::all_of(linkResults.begin(), linkResults.end(), [](const std::shared_future<bool>& result) { return result.get(); });
+
+        // Record every input and output for the no-op fast path
+        BuildManifest manifest;
+        manifest.SetOptionsHash(GetOptionsHash(configuration.name));
+        manifest.AddFile(mProjectFile);
+        for(const std::string& path : SystemHeaderState::GetWatchedPaths(toolchainProbe))
+            manifest.AddFile(path);
+        for(size_t i = 0; i < targets.size(); i++)
+        {
+            Compiler& compiler = *compilers[i];
+            for(const std::string& source : targets[i].sources)
+            {
+                manifest.AddFile(source);
+                manifest.AddFile(compiler.GetObjectPath(source));
+                for(const std::string& dependency : compiler.GetDependencies()[source])
+                    manifest.AddFile(dependency);
+            }
+            manifest.AddFile(compiler.GetBinaryPath(targets[i].name.empty() ? mProjectName : targets[i].name));
+            for(const std::string& library : linkedLibraries[i])
+                manifest.AddFile(library);
+        }
+
+        // A missing file means some step failed, the next build must not be skipped
+        if(success && manifest.Finalize())
+            manifest.Save(cacheDir + "/manifest");
+
+        // Append this build to the history
+        BuildHistory::BuildRecord record;
+        record.timestamp = static_cast<int64_t>(std::time(nullptr));
+        record.wallSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - startTime).count();
+        record.gitHead = Utils::GetGitHead(mProjectRootDir);
+        for(std::unique_ptr<Compiler>& compiler : compilers)
+        {
+            std::vector<BuildHistory::SourceRecord>& sources = compiler->GetSourceRecords();
+            record.sources.insert(record.sources.end(), sources.begin(), sources.end());
+        }
+
+        BuildHistory history;
+        history.Load(cacheDir + "/history");
+        history.Append(std::move(record));
+        history.Save(cacheDir + "/history");
+
+        return success;
+    }
+
+    void BuildSystem::GetResourcePools(const std::string& cacheDir, std::unordered_map<std::string, size_t>& limitsOut,
+                                       std::unordered_map<std::string, std::string>& sourcePoolsOut)
+    {
+        // Listed sources first, the first pool listing a source gets it
+        for(const ResourcePool& pool : mResourcePools)
+        {
+            limitsOut[pool.name] = pool.depth;
+            for(const std::string& source : pool.sources)
+                sourcePoolsOut.emplace(source, pool.name);
+        }
+
+        std::vector<const ResourcePool*> memoryPools;
+        for(const ResourcePool& pool : mResourcePools)
+        {
+            if(pool.minMemoryKB > 0)
+                memoryPools.push_back(&pool);
+        }
+
+        if(!memoryPools.empty())
+        {
+            // A source goes to the pool with the highest threshold it reaches
+            std::sort(memoryPools.begin(), memoryPools.end(), [](const ResourcePool* a, const ResourcePool* b) {
+                return a->minMemoryKB > b->minMemoryKB;
+            });
+
+            for(const auto& [source, compile] : GetLatestCompiles(cacheDir + "/history"))
+            {
+                for(const ResourcePool* pool : memoryPools)
+                {
+                    if(compile.peakMemoryKB >= pool->minMemoryKB)
+                    {
+                        sourcePoolsOut.emplace(source, pool->name);
+                        break;
+                    }
+                }
+            }
+        }
+
+        if(mVerbosityLevel == VerbosityLevel::Extended)
+        {
+            for(const ResourcePool& pool : mResourcePools)
+            {
+                size_t count = std::count_if(sourcePoolsOut.begin(), sourcePoolsOut.end(), [&pool](const auto& entry) { return entry.second == pool.name; });
+                std::cout << ("Resource pool " + pool.name + " (depth " + std::to_string(pool.depth) + "): " + std::to_string(count) + " sources\n");
+            }
+        }
+    }
+
+    std::vector<size_t> BuildSystem::GetLinkOrder(size_t targetIndex)
+    {
+        std::vector<size_t> order;
+        std::function<void(size_t)> visit = [&](size_t index) {
+            for(size_t dependency : mTargets[index].dependencies)
+            {
+                order.push_back(dependency);
+                if(mTargets[dependency].type == TargetType::StaticLibrary)
+                    visit(dependency);
+            }
+        };
+        visit(targetIndex);
+
+        // Keeps the last occurrence, a library has to come after everything that uses it
+        std::vector<size_t> result;
+        for(size_t i = order.size(); i-- > 0;)
+        {
+            if(std::find(result.begin(), result.end(), order[i]) == result.end())
+                result.insert(result.begin(), order[i]);
+        }
+        return result;
+    }
+
+    void BuildSystem::DisplayHistory(int buildCount)
+    {
+        BuildHistory history;
+        history.Load(mProjectCacheDir + "/history");
+        history.DisplayReport(buildCount);
+    }
+
+    void BuildSystem::DisplayAffectedSources(const std::vector<std::string>& files)
+    {
+        std::vector<std::string> stateFiles;
+        for(const Target& target : mTargets)
+            stateFiles.push_back(mProjectCacheDir + "/" + target.name + "/dependencies");
+        if(mTargets.empty())
+            stateFiles.push_back(mProjectCacheDir + "/dependencies");
+
+        std::vector<DependencyState> states;
+        for(const std::string& stateFile : stateFiles)
+        {
+            DependencyState state;
+            if(state.Load(stateFile))
+                states.push_back(std::move(state));
+        }
+
+        if(states.empty())
+        {
+            std::cout << "No dependency information recorded, build the project first\n";
+            return;
+        }
+
+        std::set<std::string> sources;
+        for(const std::string& file : files)
+        {
+            bool found = false;
+            for(DependencyState& state : states)
+            {
+                std::vector<std::string> dependents = state.GetDependents(file);
+                found = found || !dependents.empty();
+                sources.insert(dependents.begin(), dependents.end());
+            }
+
+            if(!found)
+                std::cout << "WARNING: BuildSystem: No source depends on: " << file << "\n";
+        }
+
+        for(const std::string& source : sources)
+            std::cout << source << "\n";
     }
 
     void BuildSystem::DisplayBuildInfo()
@@ -206,6 +853,15 @@ namespace Leo
         for(std::string& source : mSourceFiles)
             std::cout << "    " << source << "\n";
 
+        for(Target& target : mTargets)
+        {
+            std::cout << "Target " << target.name << ":\n";
+            for(std::string& source : target.sources)
+                std::cout << "    " << source << "\n";
+            for(size_t dependency : target.dependencies)
+                std::cout << "    uses " << mTargets[dependency].name << "\n";
+        }
+
         std::cout << "Headers:\n";
         for(std::string& header : mHeaderFiles)
             std::cout << "    " << header << "\n";
@@ -296,4 +952,138 @@ namespace Leo
     {
         mVerbosityLevel = level;
     }
+
+    uint64_t BuildSystem::GetOptionsHash(const std::string& configurationName)
+    {
+        // Object and binary paths are relative to the working directory
+        uint64_t hash = Utils::HashString(std::filesystem::current_path().string());
+        hash = Utils::HashString(GetBuildDir(configurationName), hash);
+        return Utils::HashString(mCompilerPath, hash);
+    }
+
+    std::string BuildSystem::GetBuildDir(const std::string& configurationName) const
+    {
+        if(configurationName.empty())
+            return mBuildDir;
+
+        return (mBuildDir.empty() ? std::string(".") : mBuildDir) + "/" + configurationName;
+    }
+
+    std::string BuildSystem::GetCacheDir(const std::string& projectFile, const std::string& configurationName) const
+    {
+        std::string buildDir = GetBuildDir(configurationName);
+        if(!buildDir.empty())
+            return Utils::NormalizePath(Utils::GetAbsolutePath(buildDir)) + "/LeoProjectCache";
+
+        return Utils::StripFilePath(Utils::GetAbsolutePath(projectFile)) + "/LeoProjectCache";
+    }
+
+    void BuildSystem::SetCompilerPath(std::string compilerPath)
+    {
+        mCompilerPath = compilerPath;
+    }
+
+    void BuildSystem::SetJobCount(size_t jobCount)
+    {
+        mJobCount = jobCount;
+    }
+
+    void BuildSystem::SetKeepGoing(bool option)
+    {
+        mKeepGoing = option;
+    }
+
+    void BuildSystem::SetBatchSize(size_t batchSize)
+    {
+        mBatchSize = batchSize;
+    }
+
+    void BuildSystem::SetDirectCompile(bool option)
+    {
+        mDirectCompile = option;
+    }
+
+    void BuildSystem::SetTimeTrace(bool option)
+    {
+        mTimeTrace = option;
+    }
+
+    void BuildSystem::SetAnalyzeIncludes(bool option)
+    {
+        mAnalyzeIncludes = option;
+    }
+
+    void BuildSystem::SetBuildDir(std::string buildDir)
+    {
+        mBuildDir = buildDir;
+    }
+
+    void BuildSystem::SetConfiguration(std::string name)
+    {
+        mConfigurationName = name;
+    }
+
+    std::string BuildSystem::GetProjectName() const
+    {
+        return mProjectName;
+    }
+
+    const std::vector<std::string>& BuildSystem::GetProjectDependencies() const
+    {
+        return mProjectDependencyNames;
+    }
+
+    void BuildSystem::AddProjectDependency(const BuildSystem* project, std::shared_future<bool> built)
+    {
+        mProjectDependencies.push_back({ project, built });
+    }
+
+    std::vector<std::string> BuildSystem::GetLibraryOutputs(const std::string& configurationName) const
+    {
+        auto built = mLibraryOutputs.find(configurationName);
+        if(built != mLibraryOutputs.end())
+            return built->second;
+
+        // Not built in this run, the last build left the compiler's answers in the cache
+        ToolchainProbe toolchainProbe;
+        toolchainProbe.Probe(mCompilerPath.empty() ? "g++" : mCompilerPath, GetCacheDir(mProjectFile, configurationName) + "/toolchain");
+
+        std::vector<std::string> outputs;
+        for(size_t index : GetLibraryOrder())
+        {
+            const Target& target = mTargets[index];
+            Compiler compiler;
+            compiler.SetActiveToolchain(toolchainProbe.IsClang() ? Compiler::Toolchain::Clang : Compiler::Toolchain::MinGW);
+            compiler.SetToolchainProbe(toolchainProbe);
+            std::string buildDir = GetBuildDir(configurationName);
+            if(!buildDir.empty())
+                compiler.SetBuildDir(buildDir);
+            compiler.SetTarget(target.name, target.type);
+            outputs.push_back(compiler.GetBinaryPath(target.name));
+        }
+        return outputs;
+    }
+
+    std::vector<size_t> BuildSystem::GetLibraryOrder() const
+    {
+        // Reverse post-order, so every library comes before the ones it uses
+        std::vector<size_t> order;
+        std::vector<char> visited(mTargets.size(), 0);
+        std::function<void(size_t)> visit = [&](size_t index) {
+            if(visited[index])
+                return;
+            visited[index] = 1;
+            for(size_t dependency : mTargets[index].dependencies)
+                visit(dependency);
+            order.push_back(index);
+        };
+
+        for(size_t i = 0; i < mTargets.size(); i++)
+        {
+            if(mTargets[i].type != TargetType::Executable)
+                visit(i);
+        }
+
+        return std::vector<size_t>(order.rbegin(), order.rend());
+    }
 }
\ No newline at end of file
@@ -1,9 +1,61 @@
 #include "Compilers.hpp"
+#include "TimeTrace.hpp"
+#include "IncludeAnalysis.hpp"
 #include "Utils.hpp"
-
+#include "StatCache.hpp"
+#include "Fingerprint.hpp"
+#include "JobPool.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <cstdio>
+#include <cctype>
+#include <iterator>
 #include <sstream>
+#include <algorithm>
+#include <unordered_set>
+
+// Token fingerprints of the files read by this process, keyed by stamp digest and ChangeDetection mode.
+// Configurations built side by side read each source and header only once
+static std::mutex fingerprintMutex;
+static std::unordered_map<uint64_t, uint64_t> fingerprints;
+
+static bool FindFingerprint(uint64_t key, uint64_t& fingerprintOut)
+{
+    std::lock_guard<std::mutex> lock(fingerprintMutex);
+    auto it = fingerprints.find(key);
+    if(it == fingerprints.end())
+        return false;
+
+    fingerprintOut = it->second;
+    return true;
+}
+
+static void StoreFingerprint(uint64_t key, uint64_t fingerprint)
+{
+    std::lock_guard<std::mutex> lock(fingerprintMutex);
+    fingerprints[key] = fingerprint;
+}
+
+static bool ReadWholeFile(const std::string& path, std::string& contentsOut)
+{
+    std::ifstream file(path, std::ios::binary);
+    if(!file.is_open())
+        return false;
+
+    contentsOut.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
 
-static std::filesystem::file_time_type referenceTime;
+static void RecordCompileStats(Leo::BuildHistory::SourceRecord& record, const Utils::ProcessStats& stats)
+{
+    record.cacheHit = false;
+    record.wallSeconds = static_cast<float>(stats.wallSeconds);
+    record.cpuSeconds = static_cast<float>(stats.cpuSeconds);
+    record.peakMemoryKB = static_cast<uint32_t>(stats.peakMemoryKB);
+}
 
 namespace Leo
 {
@@ -13,7 +65,6 @@ namespace Leo
     {
         mProjectRootDir = projectRootDir;
         mProjectCacheDir = projectCacheDir;
-        referenceTime = Utils::GetFileModifiedTime(mProjectCacheDir + "/reference");
     }
 
     void ToolchainBase::SetSources(
@@ -49,21 +100,50 @@ namespace Leo
         mCleanBuild = option;
     }
 
+    void ToolchainBase::SetCompilerPath(std::string compilerPath)
+    {
+        mCompilerPath = compilerPath;
+    }
+
+    void ToolchainBase::SetBuildDir(std::string buildDir)
+    {
+        mBuildDir = Utils::NormalizePath(buildDir);
+        while(mBuildDir.size() > 1 && mBuildDir.back() == '/')
+            mBuildDir.pop_back();
+    }
+
+    void ToolchainBase::SetTarget(std::string name, TargetType type)
+    {
+        mTargetName = name;
+        mTargetType = type;
+    }
+
     bool ToolchainBase::SetupState()
     {
-        if(!Utils::PathExists("./obj"))
-            Utils::CreateDirectory("./obj");
-        
-        if(!Utils::PathExists("./bin"))
-            Utils::CreateDirectory("./bin");
+        // Mirrored object paths need the source directories under obj/
+        std::unordered_set<std::string> directories;
+        directories.insert(mBuildDir + "/bin");
+        for(const std::string& source : mSourceFiles)
+            directories.insert(Utils::StripFilePath(GetObjectPath(source)));
+
+        for(const std::string& directory : directories)
+        {
+            std::error_code error;
+            std::filesystem::create_directories(directory, error);
+            if(error)
+            {
+                std::cout << "ERROR: Toolchain: Can't create directory " << directory << " (" << error.message() << ")\n";
+                return false;
+            }
+        }
 
         return true;
     }
 
-    std::vector<std::string> ToolchainBase::ExamineSources()
+    void ToolchainBase::ExamineSources(const std::function<void(const std::string&)>& onChanged)
     {
-        // Nothing :)
-        return mSourceFiles;
+        for(const std::string& file : mSourceFiles)
+            onChanged(file);
     }
 
     void ToolchainBase::MakeDependencyTree(std::string depsData, std::vector<std::string>& depsOut)
@@ -71,18 +151,214 @@ namespace Leo
         // Nothing :)
     }
 
+    std::vector<BuildHistory::SourceRecord>& ToolchainBase::GetSourceRecords()
+    {
+        return mSourceRecords;
+    }
+
+    std::unordered_map<std::string, std::vector<std::string>>& ToolchainBase::GetDependencies()
+    {
+        return mDependencies;
+    }
+
+    std::string ToolchainBase::GetObjectPath(const std::string& source)
+    {
+        // Sources below the working directory keep their relative path, so equal file names don't clash.
+        // Anything else is named after a hash of its path
+        std::string objectDir = mBuildDir + (mTargetName.empty() ? "/obj/" : "/obj/" + mTargetName + "/");
+        std::filesystem::path path = std::filesystem::path(Utils::NormalizePath(source)).lexically_normal();
+        if(path.is_relative() && !path.empty() && *path.begin() != "..")
+            return objectDir + path.generic_string() + ".obj";
+
+        char hash[17];
+        std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(Utils::HashString(path.generic_string())));
+        return objectDir + "external/" + hash + "-" + path.filename().string() + ".obj";
+    }
+
+    std::string ToolchainBase::GetBinaryPath(const std::string& outFileName)
+    {
+        switch(mTargetType)
+        {
+        case TargetType::StaticLibrary:
+            return mBuildDir + "/bin/lib" + outFileName + ".a";
+
+        case TargetType::SharedLibrary:
+            if(mToolchainProbe.TargetsWindows())
+                return mBuildDir + "/bin/" + outFileName + ".dll";
+            return mBuildDir + "/bin/lib" + outFileName + ".so";
+
+        default:
+            return mBuildDir + "/bin/" + outFileName;
+        }
+    }
+
+    bool ToolchainBase::ReadDependencyFile(std::string path, std::vector<std::string>& depsOut)
+    {
+        std::ifstream file(path);
+        if(!file.is_open())
+            return false;
+
+        std::string buf;
+        while(!file.eof())
+        {
+            std::string tmp;
+            std::getline(file, tmp);
+            buf += tmp;
+        }
+        file.close();
+
+        return ParseDependencyRule(buf, depsOut);
+    }
+
+    bool ToolchainBase::ParseDependencyRule(std::string rule, std::vector<std::string>& depsOut)
+    {
+        // Line breaks only continue the rule, they separate paths like any other whitespace
+        for(char& c : rule)
+            if(c == '\n' || c == '\r') c = ' ';
+
+        // Rule looks like "<target>: <source> <dependencies...>"
+        std::string::size_type pos = rule.find(": ");
+        if(pos == std::string::npos)
+            return false;
+
+        MakeDependencyTree(rule.substr(pos + 2), depsOut);
+
+        // First prerequisite is the source itself
+        if(!depsOut.empty())
+            depsOut.erase(depsOut.begin());
+
+        return true;
+    }
+
+    void ToolchainBase::SetKeepGoing(bool option)
+    {
+        mKeepGoing = option;
+    }
+
+    void ToolchainBase::SetJobCount(size_t jobCount)
+    {
+        mJobCount = jobCount;
+    }
+
+    void ToolchainBase::SetJobPool(JobPool* jobPool)
+    {
+        mJobPool = jobPool;
+    }
+
+    void ToolchainBase::SetResourcePools(std::unordered_map<std::string, size_t> limits, std::unordered_map<std::string, std::string> sourcePools)
+    {
+        mResourceLimits = limits;
+        mSourcePools = sourcePools;
+    }
+
+    void ToolchainBase::SetDirectCompile(bool option)
+    {
+        mDirectCompile = option;
+    }
+
+    void ToolchainBase::SetToolchainProbe(const ToolchainProbe& probe)
+    {
+        mToolchainProbe = probe;
+        mArchiverPath = probe.GetArchiverPath();
+    }
+
+    void ToolchainBase::SetTimeTrace(bool option)
+    {
+        mTimeTrace = option;
+    }
+
+    void ToolchainBase::SetCompileBatching(size_t maxBatchSize, std::unordered_map<std::string, float> smallSources)
+    {
+        mBatchSize = maxBatchSize;
+        mBatchSources = smallSources;
+    }
+
+    void ToolchainBase::SetChangeDetection(ChangeDetection option)
+    {
+        mChangeDetection = option;
+    }
+
+    uint64_t ToolchainBase::GetDependencyDigest(const std::string& source)
+    {
+        // Folded in dependency file order
+        const std::vector<std::string>& deps = mDependencies[source];
+        uint64_t digest = Utils::HashValue(deps.size());
+        digest = Utils::HashValue(GetContentDigest(source), digest);
+        for(const std::string& path : deps)
+            digest = Utils::HashValue(GetContentDigest(path), digest);
+
+        return digest;
+    }
+
+    uint64_t ToolchainBase::GetContentDigest(const std::string& path)
+    {
+        auto it = mContentDigests.find(path);
+        if(it != mContentDigests.end())
+            return it->second;
+
+        StatCache& statCache = GetStatCache();
+        StatCache::PathId id = statCache.Intern(path);
+        uint64_t digest = statCache.GetDigest(id);
+
+        if(mChangeDetection != ChangeDetection::Timestamps && statCache.Get(id).exists)
+        {
+            // Tokens are only looked at again if the stamp changed since the last build
+            uint64_t lastStampDigest = 0;
+            uint64_t lastContentDigest = 0;
+            uint64_t key = Utils::HashValue(static_cast<uint64_t>(mChangeDetection), digest);
+            if(mDependencyState.GetFileDigests(path, lastStampDigest, lastContentDigest) && lastStampDigest == digest)
+            {
+                digest = lastContentDigest;
+            }
+            else if(!FindFingerprint(key, digest))
+            {
+                std::vector<std::string> contents;
+                std::vector<bool> found;
+                GetFileService().Read({ path }, contents, found);
+                if(found[0])
+                {
+                    digest = MakeContentDigest(path, contents[0]);
+                    StoreFingerprint(key, digest);
+                }
+            }
+        }
+
+        mContentDigests[path] = digest;
+        return digest;
+    }
+
+    uint64_t ToolchainBase::MakeContentDigest(const std::string& path, const std::string& contents)
+    {
+        bool keepLines = (mChangeDetection == ChangeDetection::Tokens);
+        return GetTokenFingerprint(contents, keepLines, Utils::HashString(path));
+    }
+
+    uint64_t ToolchainBase::GetCommandDigest(const std::vector<std::string>& arguments)
+    {
+        // Lengths keep "-O", "2" apart from "-O2". Another compiler version produces other objects
+        uint64_t digest = Utils::HashString(mCompilerPath, mToolchainProbe.GetIdentity());
+        for(const std::string& argument : arguments)
+            digest = Utils::HashString(argument, Utils::HashValue(argument.size(), digest));
+
+        return digest;
+    }
+
 
-    std::vector<std::string> ToolchainBase::Compile()
+    bool ToolchainBase::Compile(std::vector<std::string>& objectFiles)
     {
         std::vector<std::string> command;
-        std::vector<std::string> objectFiles;
+        objectFiles.clear();
 
         if(mSourceFiles.empty())
         {
             std::cout << "ERROR: Toolchain: No source files available\n";
-            return objectFiles;
+            return false;
         }
 
+        // Directories of the object layout are created once the sources are known
+        if(!SetupState())
+            return false;
+
         command.push_back("-c");
 
         for(std::string item : mCompilerFlags)
@@ -96,7 +372,7 @@ namespace Leo
 
         for(std::string file : mSourceFiles)
         {
-            objectFiles.push_back("./obj/" + Utils::StripFileName(file) + ".obj");
+            objectFiles.push_back(GetObjectPath(file));
             std::cout << "Compiling: " << file << " > " << objectFiles.back() << "\n";
 
             command.push_back(file);
@@ -108,17 +384,17 @@ namespace Leo
             command.erase(command.end() - 3, command.end());
         }
 
-        return objectFiles;
+        return true;
     }
 
-    void ToolchainBase::Link(std::string outFileName, std::vector<std::string>& objectFiles)
+    bool ToolchainBase::Link(std::string outFileName, std::vector<std::string>& objectFiles)
     {
         std::vector<std::string> command;
 
         if(objectFiles.empty())
         {
             std::cout << "ERROR: Toolchain: No object files available\n";
-            return;
+            return false;
         }
 
         for(std::string item : mLinkerFlags)
@@ -135,10 +411,17 @@ namespace Leo
 
         std::cout << "Linking final executable\n";
         command.push_back("-o");
-        command.push_back("bin/" + outFileName);
+        command.push_back(GetBinaryPath(outFileName));
 
         // run command
         std::cout << "Saved final executable: \"" << outFileName << "\"\n";
+        return true;
+    }
+
+    bool ToolchainBase::AnalyzeIncludes(IncludeAnalysis&)
+    {
+        std::cout << "ERROR: Toolchain: " << mName << " can't analyze includes\n";
+        return false;
     }
 
 
@@ -146,80 +429,128 @@ namespace Leo
 
     bool ToolchainMinGW::SetupState()
     {
-        if(!Utils::PathExists("./obj"))
-            Utils::CreateDirectory("./obj");
-        
-        if(!Utils::PathExists("./bin"))
-            Utils::CreateDirectory("./bin");
-
-        return true;
+        return ToolchainBase::SetupState();
     }
 
-    std::vector<std::string> ToolchainMinGW::ExamineSources()
+    void ToolchainMinGW::ExamineSources(const std::function<void(const std::string&)>& onChanged)
     {
-        std::vector<std::string> changedFiles;
-
-        std::vector<std::string> command;
-        command.push_back("-M");
-        command.push_back("-MT");
-        command.push_back("a");
-        command.push_back("-MF");
-        command.push_back(mProjectCacheDir + "/out.dep");
+        StatCache& statCache = GetStatCache();
+        mContentDigests.clear();
 
-        for(std::string item : mCompilerDefines)
-            command.push_back("-D" + item);
-
-        for(std::string item : mCompilerIncludeDirectories)
-            command.push_back("-I" + item);
-
-        command.push_back("-E");
-
-        for(const std::string& source : mSourceFiles)
+        enum class SourceState
         {
-            // Make a list of dependencies            
-            command.push_back(source);
-            Utils::StartProcessAndWait("g++", command);
-            command.pop_back();
+            Unknown,
+            Changed,
+            UpToDate
+        };
+
+        std::vector<SourceState> sourceStates(mSourceFiles.size(), SourceState::Unknown);
+        std::vector<uint64_t> lastDigests(mSourceFiles.size(), 0);
+        std::unordered_map<std::string, size_t> sourceIndices;
+
+        auto report = [&](size_t index) {
+            sourceStates[index] = SourceState::Changed;
+            onChanged(mSourceFiles[index]);
+        };
+
+        // Sources that never compiled successfully have no record and lost objects have to be rebuilt,
+        // both start compiling before any header is looked at
+        std::vector<StatCache::PathId> objectIds;
+        for(const std::string& source : mSourceFiles)
+            objectIds.push_back(statCache.Intern(GetObjectPath(source)));
+        statCache.Prefetch(objectIds);
 
-            std::string buf;
-            std::ifstream file(mProjectCacheDir + "/out.dep");
-            while(!file.eof())
+        for(size_t i = 0; i < mSourceFiles.size(); i++)
+        {
+            const std::string& source = mSourceFiles[i];
+            sourceIndices[source] = i;
+
+            // A changed flag, define or include directory rebuilds every source whose command it is part of
+            uint64_t lastCommandDigest = 0;
+            if(!mDependencyState.GetSource(source, lastDigests[i], lastCommandDigest, mDependencies[source])
+               || lastCommandDigest != GetCommandDigest(GetCompileArguments(source))
+               || !statCache.Get(objectIds[i]).exists)
             {
-                std::string tmp;
-                std::getline(file, tmp);
-                buf += tmp;
+                report(i);
             }
-            file.close();
+        }
+
+        // Start from the changed files and only look at the sources including them.
+        // Files are stat'ed in chunks so the first changed sources compile while the rest is checked
+        const size_t chunkSize = 1024;
+        std::vector<std::string> knownFiles = mDependencyState.GetFiles();
+        for(size_t begin = 0; begin < knownFiles.size(); begin += chunkSize)
+        {
+            size_t end = std::min(begin + chunkSize, knownFiles.size());
 
-            // Trim unnecessary parts from 'buf'
-            std::string leftTrim = "a: " + source + " ";
-            buf = buf.substr(leftTrim.length());
-            
-            std::vector<std::string> deps;
-            MakeDependencyTree(buf, deps);
+            std::vector<StatCache::PathId> ids;
+            for(size_t i = begin; i < end; i++)
+                ids.push_back(statCache.Intern(knownFiles[i]));
+            statCache.Prefetch(ids);
 
-            // Check if the source file itself has changed
-            if(Utils::FileModified(source, referenceTime))
+            // Files with a new stamp are read in one batch to see if their tokens changed as well
+            if(mChangeDetection != ChangeDetection::Timestamps)
             {
-                changedFiles.push_back(source);
-                continue;
+                std::vector<std::string> touchedFiles;
+                std::vector<uint64_t> touchedKeys;
+                for(size_t i = begin; i < end; i++)
+                {
+                    uint64_t lastStampDigest = 0;
+                    uint64_t lastContentDigest = 0;
+                    bool known = mDependencyState.GetFileDigests(knownFiles[i], lastStampDigest, lastContentDigest);
+                    StatCache::PathId id = ids[i - begin];
+                    if(!statCache.Get(id).exists || (known && statCache.GetDigest(id) == lastStampDigest))
+                        continue;
+
+                    // Another configuration may have read it already
+                    uint64_t key = Utils::HashValue(static_cast<uint64_t>(mChangeDetection), statCache.GetDigest(id));
+                    uint64_t fingerprint = 0;
+                    if(FindFingerprint(key, fingerprint))
+                    {
+                        mContentDigests[knownFiles[i]] = fingerprint;
+                        continue;
+                    }
+
+                    touchedFiles.push_back(knownFiles[i]);
+                    touchedKeys.push_back(key);
+                }
+
+                std::vector<std::string> contents;
+                std::vector<bool> found;
+                GetFileService().Read(touchedFiles, contents, found);
+                for(size_t i = 0; i < touchedFiles.size(); i++)
+                {
+                    if(!found[i])
+                        continue;
+
+                    uint64_t fingerprint = MakeContentDigest(touchedFiles[i], contents[i]);
+                    mContentDigests[touchedFiles[i]] = fingerprint;
+                    StoreFingerprint(touchedKeys[i], fingerprint);
+                }
             }
 
-            // Chech if its dependencies have changed
-            for(const std::string& path : deps)
+            for(size_t i = begin; i < end; i++)
             {
-                if(Utils::FileModified(path, referenceTime))
+                uint64_t lastStampDigest = 0;
+                uint64_t lastContentDigest = 0;
+                mDependencyState.GetFileDigests(knownFiles[i], lastStampDigest, lastContentDigest);
+                if(GetContentDigest(knownFiles[i]) == lastContentDigest)
+                    continue;
+
+                for(const std::string& source : mDependencyState.GetDependents(knownFiles[i]))
                 {
-                    changedFiles.push_back(source);
-                    // We only need a single changed file to recompile the source
-                    // It's practically worthless to continue checking any further
-                    break;
+                    auto it = sourceIndices.find(source);
+                    if(it == sourceIndices.end() || sourceStates[it->second] != SourceState::Unknown)
+                        continue;
+
+                    // Any changed, added, removed or missing dependency gives the source a different digest
+                    if(lastDigests[it->second] != GetDependencyDigest(source))
+                        report(it->second);
+                    else
+                        sourceStates[it->second] = SourceState::UpToDate;
                 }
             }
         }
-
-        changedFiles.shrink_to_fit();
-        return changedFiles;
     }
 
     void ToolchainMinGW::MakeDependencyTree(std::string depsData, std::vector<std::string>& depsOut)
@@ -237,6 +568,9 @@ namespace Leo
             std::string tmp;
             data >> tmp;
 
+            // Trailing whitespace leaves nothing to read
+            if(tmp.empty()) continue;
+
             // Makefile rules can be split into multiple lines by '\' character
             // While breaking whitespaces, "\" is also returned as a string sequence
             // We don't need it so get rid of it
@@ -264,29 +598,120 @@ namespace Leo
         depsOut.shrink_to_fit();
     }
 
-    std::vector<std::string> ToolchainMinGW::Compile()
+    std::vector<std::string> ToolchainMinGW::GetCompileArguments(const std::string& source)
     {
-        std::vector<std::string> command;
-        std::vector<std::string> objectFiles;
+        // Dependency list is written as a side effect and reused by the next build.
+        // The object gets its real name once the compiler succeeded, see Compile()
+        std::string objectFile = GetObjectPath(source);
+        std::vector<std::string> arguments = mCompileCommand;
+        arguments.push_back(source);
+        arguments.push_back("-o");
+        arguments.push_back(objectFile + ".tmp");
+        arguments.push_back("-MD");
+        arguments.push_back("-MF");
+        arguments.push_back(objectFile + ".d");
+        return arguments;
+    }
 
-        if(mSourceFiles.empty())
+    int ToolchainMinGW::RunCompile(const std::string& source, const std::vector<std::string>& arguments, Utils::ProcessStats& statsOut)
+    {
+        std::string objectFile = GetObjectPath(source);
+        std::vector<std::vector<std::string>> commands;
+        std::vector<std::string> intermediates;
+        if(!mDirectCompile || UsesSingleCompiles() || !mDirectCompileCache.GetCommands(mCompilerPath, arguments, source, objectFile + ".tmp", objectFile + ".d", commands, intermediates))
+            return Utils::StartProcessAndWait(mCompilerPath, arguments, &statsOut);
+
+        // Every program reads what the one before wrote, like in the driver's pipeline
+        int exitCode = 0;
+        for(const std::vector<std::string>& command : commands)
         {
-            std::cout << "ERROR: Toolchain: No source files available\n";
-            return objectFiles;
+            Utils::ProcessStats stats;
+            exitCode = Utils::StartProcessAndWait(command[0], std::vector<std::string>(command.begin() + 1, command.end()), &stats);
+            statsOut.wallSeconds += stats.wallSeconds;
+            statsOut.cpuSeconds += stats.cpuSeconds;
+            statsOut.peakMemoryKB = std::max(statsOut.peakMemoryKB, stats.peakMemoryKB);
+            if(exitCode != 0)
+                break;
         }
 
-        std::cout << "Checking dependencies...\n";
-        std::vector<std::string> changedFiles;
-        if(!mCleanBuild)
+        std::error_code error;
+        for(const std::string& intermediate : intermediates)
+            std::filesystem::remove(intermediate, error);
+        return exitCode;
+    }
+
+    std::vector<std::string> ToolchainMinGW::GetBatchArguments(const std::string& batchDir, const std::vector<std::string>& sources)
+    {
+        std::vector<std::string> arguments;
+        for(const std::string& argument : mCompileCommand)
         {
-            changedFiles = ExamineSources();
-            if(changedFiles.empty())
-            {
-                std::cout << "All files are up to date\n";
-                return objectFiles;
-            }
+            if(argument.compare(0, 2, "-I") == 0 && argument.length() > 2)
+                arguments.push_back("-I" + Utils::GetAbsolutePath(argument.substr(2)));
+            else
+                arguments.push_back(argument);
+        }
+
+        // The last matching map wins: paths under the working directory lose it again and the scratch
+        // directory, recorded as the compilation directory, becomes the working directory
+        std::string workingDir = Utils::NormalizePath(std::filesystem::current_path().string());
+        arguments.push_back("-ffile-prefix-map=" + workingDir + "/=");
+        arguments.push_back("-ffile-prefix-map=" + Utils::NormalizePath(Utils::GetAbsolutePath(batchDir)) + "=" + workingDir);
+
+        arguments.push_back("-MD");
+        for(const std::string& source : sources)
+            arguments.push_back(Utils::GetAbsolutePath(source));
+        return arguments;
+    }
+
+    bool ToolchainMinGW::MoveBatchOutputs(const std::string& batchDir, const std::string& source)
+    {
+        std::string name = batchDir + "/" + std::filesystem::path(source).stem().string();
+        std::string objectFile = GetObjectPath(source);
+
+        // Paths below the working directory are written relative again, like a single compile does
+        std::string rule;
+        if(!ReadWholeFile(name + ".d", rule))
+            return false;
+
+        std::string prefix = Utils::NormalizePath(std::filesystem::current_path().string()) + "/";
+        for(size_t position = rule.find(prefix); position != std::string::npos; position = rule.find(prefix, position + 1))
+        {
+            if(position == 0 || std::isspace(static_cast<unsigned char>(rule[position - 1])))
+                rule.erase(position, prefix.length());
         }
 
+        std::ofstream dependencyFile(objectFile + ".d", std::ios::binary | std::ios::trunc);
+        dependencyFile << rule;
+        dependencyFile.close();
+
+        std::error_code error;
+        std::filesystem::rename(name + ".o", objectFile, error);
+        return dependencyFile.good() && !error;
+    }
+
+    bool ToolchainMinGW::ReadLinkDigest(uint64_t& digestOut)
+    {
+        std::ifstream file(mProjectCacheDir + "/link", std::ios::binary);
+        if(!file.is_open())
+            return false;
+
+        uint32_t magic = 0;
+        Utils::ReadBinary(file, magic);
+        Utils::ReadBinary(file, digestOut);
+        return file && magic == 0x4c4f454c; // "LEOL"
+    }
+
+    void ToolchainMinGW::WriteLinkDigest(uint64_t digest)
+    {
+        std::ofstream file(mProjectCacheDir + "/link", std::ios::binary | std::ios::trunc);
+        Utils::WriteBinary(file, static_cast<uint32_t>(0x4c4f454c));
+        Utils::WriteBinary(file, digest);
+    }
+
+    void ToolchainMinGW::SetupCompileCommand()
+    {
+        std::vector<std::string>& command = mCompileCommand;
+        command.clear();
         command.push_back("-c");
 
         for(std::string item : mCompilerFlags)
@@ -298,95 +723,622 @@ namespace Leo
         for(std::string item : mCompilerIncludeDirectories)
             command.push_back("-I" + item);
 
-        if(mCleanBuild)
+        // Shared library code has to work at any address
+        if(mTargetType == TargetType::SharedLibrary && !mToolchainProbe.TargetsWindows())
+            command.push_back("-fPIC");
+    }
+
+    bool ToolchainMinGW::UsesSingleCompiles() const
+    {
+        return mTimeTrace;
+    }
+
+    bool ToolchainMinGW::Compile(std::vector<std::string>& objectFiles)
+    {
+        objectFiles.clear();
+
+        if(mSourceFiles.empty())
         {
-            for(std::string& file : mSourceFiles)
-            {
-                objectFiles.push_back("./obj/" + Utils::StripFileName(file) + ".obj");
-                std::cout << "Compiling: " << file << " > " << objectFiles.back() << "\n";
+            std::cout << "ERROR: Toolchain: No source files available\n";
+            return false;
+        }
 
-                command.push_back(file);
-                command.push_back("-o");
-                command.push_back(objectFiles.back());
+        // Directories of the object layout are created once the sources are known
+        if(!SetupState())
+            return false;
 
-                Utils::StartProcessAndWait("g++", command);
+        SetupCompileCommand();
+        uint64_t flagHash = Utils::HashString(mCompilerPath, mToolchainProbe.GetIdentity());
+        for(const std::string& item : mCompileCommand)
+            flagHash = Utils::HashString(item, flagHash);
 
-                command.erase(command.end() - 3, command.end());
-            }
+        mSourceRecords.clear();
+        std::unordered_map<std::string, size_t> recordIndices;
+        for(const std::string& file : mSourceFiles)
+        {
+            BuildHistory::SourceRecord record;
+            record.source = file;
+            record.cacheHit = true;
+            record.flagHash = flagHash;
+            recordIndices[file] = mSourceRecords.size();
+            mSourceRecords.push_back(record);
+            objectFiles.push_back(GetObjectPath(file));
         }
-        else
+
+        enum class JobResult
+        {
+            NotRun,
+            Succeeded,
+            Failed
+        };
+
+        // System headers are left out of the dependencies of each source and checked as a unit. Which sources
+        // include a changed one isn't known, all of them are compiled again then
+        std::string systemHeadersPath = mProjectCacheDir + "/systemheaders";
+        uint64_t systemFingerprint = SystemHeaderState::GetFingerprint(mToolchainProbe);
+        if(mCleanBuild || !mSystemHeaders.Load(systemHeadersPath))
+        {
+            mSystemHeaders = SystemHeaderState();
+            mCleanBuild = true;
+        }
+        else if(mSystemHeaders.GetLastFingerprint() != systemFingerprint && !mSystemHeaders.Recheck())
         {
-            for(std::string& file : changedFiles)
+            std::cout << "System headers changed, compiling everything\n";
+            mSystemHeaders = SystemHeaderState();
+            mCleanBuild = true;
+        }
+        mSystemHeaders.SetLastFingerprint(systemFingerprint);
+
+        // Switching the ChangeDetection mode rebuilds everything once
+        std::string statePath = mProjectCacheDir + "/dependencies";
+        if(!mCleanBuild)
+            mDependencyState.Load(statePath);
+        if(mDependencyState.GetChangeDetection() != mChangeDetection)
+            mDependencyState = DependencyState();
+        mDependencyState.SetChangeDetection(mChangeDetection);
+        mDependencyState.OpenJournal(statePath);
+
+        // Workers only run the compiler, everything else stays on this thread.
+        // Without a shared pool the build gets one of its own
+        std::unique_ptr<JobPool> ownJobPool;
+        if(mJobPool == nullptr)
+            ownJobPool = std::make_unique<JobPool>(mJobCount);
+        JobPool& jobPool = (mJobPool != nullptr) ? *mJobPool : *ownJobPool;
+        for(const auto& [resource, limit] : mResourceLimits)
+            jobPool.SetResourceLimit(resource, limit);
+
+        // The driver is asked once per source extension and flag set, its answers are kept across builds
+        if(mDirectCompile && !UsesSingleCompiles())
+        {
+            mDirectCompileCache.Load(mProjectCacheDir + "/direct");
+            std::unordered_set<std::string> extensions;
+            for(const std::string& file : mSourceFiles)
             {
-                objectFiles.push_back("./obj/" + Utils::StripFileName(file) + ".obj");
-                std::cout << "Compiling: " << file << " > " << objectFiles.back() << "\n";
+                std::string extension = std::filesystem::path(file).extension().string();
+                if(!extensions.insert(extension).second)
+                    continue;
 
-                command.push_back(file);
-                command.push_back("-o");
-                command.push_back(objectFiles.back());
+                std::string objectFile = GetObjectPath(file);
+                if(!mDirectCompileCache.Prepare(mCompilerPath, GetCompileArguments(file), file, objectFile + ".tmp", objectFile + ".d"))
+                    std::cout << ("WARNING: Toolchain: " + extension + " sources are compiled through the driver, its commands can't be started directly\n");
+            }
+            mDirectCompileCache.Save(mProjectCacheDir + "/direct");
+        }
+
+        std::vector<std::string> compiledFiles;
+        std::vector<JobResult> results(mSourceFiles.size(), JobResult::NotRun);
+        std::vector<std::string> failedFiles;
+        std::mutex failureMutex;
+
+        // Jobs hand their record index back to this thread when done, other builds may use the pool meanwhile
+        std::vector<size_t> finishedJobs;
+        size_t pendingJobs = 0;
+        std::mutex finishedMutex;
+        std::condition_variable finishedCondition;
+
+        auto fail = [&](const std::string& file, const std::string& reason) {
+            // Compilers stopped by fail-fast aren't failures of their own
+            std::lock_guard<std::mutex> lock(failureMutex);
+            if(jobPool.IsCancelled())
+                return;
+
+            failedFiles.push_back(file);
+            std::cout << "ERROR: Toolchain: Failed to compile " << file << " (" << reason << ")\n";
+            if(!mKeepGoing)
+            {
+                jobPool.Cancel();
+                Utils::TerminateRunningProcesses();
+            }
+        };
 
-                Utils::StartProcessAndWait("g++", command);
+        // Each finished source is journaled right away, an interrupted build resumes from there.
+        // Returns false once every submitted job is handled
+        auto processFinished = [&](bool wait) {
+            std::vector<size_t> jobs;
+            {
+                std::unique_lock<std::mutex> lock(finishedMutex);
+                if(wait)
+                    finishedCondition.wait(lock, [&]() { return !finishedJobs.empty() || pendingJobs == 0; });
 
-                command.erase(command.end() - 3, command.end());
+                jobs.swap(finishedJobs);
+                if(jobs.empty() && pendingJobs == 0)
+                    return false;
             }
 
-            objectFiles.clear();
+            for(size_t index : jobs)
+            {
+                const std::string& file = mSourceRecords[index].source;
+                std::string objectFile = GetObjectPath(file);
+                GetStatCache().Invalidate(objectFile);
+                GetStatCache().Invalidate(objectFile + ".d");
 
-            for(std::string& file : mSourceFiles)
-                objectFiles.push_back("obj/" + Utils::StripFileName(file) + ".obj");
-        }        
+                // Failed and cancelled sources have no record, the next build compiles them again
+                if(results[index] != JobResult::Succeeded)
+                {
+                    mDependencyState.RemoveSource(file);
+                    continue;
+                }
 
-        return objectFiles;
-    }
+                // Stamps are the ones seen before compiling, an edit made meanwhile rebuilds next time
+                std::vector<std::string> deps;
+                std::vector<std::string> systemHeaders;
+                ReadDependencyFile(objectFile + ".d", deps);
+                mDependencies[file].clear();
+                for(std::string& dep : deps)
+                    (mToolchainProbe.IsSystemHeader(dep) ? systemHeaders : mDependencies[file]).push_back(std::move(dep));
+                mSystemHeaders.AddHeaders(systemHeaders);
+
+                mDependencyState.SetSource(file, GetDependencyDigest(file), GetCommandDigest(GetCompileArguments(file)), mDependencies[file]);
+                mDependencyState.AppendToJournal(file);
+            }
+            return true;
+        };
+
+        auto finish = [&](size_t index) {
+            std::lock_guard<std::mutex> lock(finishedMutex);
+            finishedJobs.push_back(index);
+            pendingJobs--;
+            finishedCondition.notify_one();
+        };
+
+        auto submitSingle = [&](const std::string& file, size_t index) {
+            std::vector<std::string> arguments = GetCompileArguments(file);
+            auto pool = mSourcePools.find(file);
+            jobPool.Submit([&, arguments = std::move(arguments), file, index]() {
+                if(!jobPool.IsCancelled())
+                {
+                    Utils::ProcessStats stats;
+                    int exitCode = RunCompile(file, arguments, stats);
+                    RecordCompileStats(mSourceRecords[index], stats);
+
+                    // A truncated object never gets the real name, the old one stays until a compile succeeds
+                    std::string objectFile = GetObjectPath(file);
+                    std::error_code error;
+                    if(exitCode == 0)
+                        std::filesystem::rename(objectFile + ".tmp", objectFile, error);
+                    else
+                        std::filesystem::remove(objectFile + ".tmp", error);
+
+                    if(exitCode == 0 && !error)
+                    {
+                        results[index] = JobResult::Succeeded;
+                    }
+                    else
+                    {
+                        results[index] = JobResult::Failed;
+                        fail(file, exitCode != 0 ? "exit code " + std::to_string(exitCode) : "can't replace " + objectFile);
+                    }
+                }
 
-    void ToolchainMinGW::Link(std::string outFileName, std::vector<std::string>& objectFiles)
-    {
-        std::vector<std::string> command;
+                finish(index);
+            }, (pool != mSourcePools.end()) ? pool->second : std::string());
+        };
+
+        // Small sources share one compiler run, see SetCompileBatching()
+        std::vector<std::string> batch;
+        float batchSeconds = 0.0f;
+        size_t batchCount = 0;
+        auto submitBatch = [&]() {
+            if(batch.empty())
+                return;
+
+            std::vector<std::string> files;
+            files.swap(batch);
+            batchSeconds = 0.0f;
+
+            std::vector<size_t> indices;
+            for(const std::string& file : files)
+                indices.push_back(recordIndices[file]);
+
+            std::string batchDir = mProjectCacheDir + "/batch" + std::to_string(batchCount++);
+            std::vector<std::string> arguments = GetBatchArguments(batchDir, files);
+            jobPool.Submit([&, files, indices, arguments, batchDir]() {
+                if(jobPool.IsCancelled())
+                {
+                    for(size_t index : indices)
+                        finish(index);
+                    return;
+                }
 
-        if(objectFiles.empty())
-        {
-            std::cout << "No object files available to link\n";
-            return;
-        }
+                std::error_code error;
+                std::filesystem::remove_all(batchDir, error);
+                std::filesystem::create_directories(batchDir, error);
 
-        for(std::string item : mLinkerFlags)
-            command.push_back(item);
+                Utils::ProcessStats stats;
+                int exitCode = Utils::StartProcessAndWait(mCompilerPath, arguments, &stats, batchDir, batchDir + "/output");
+                bool succeeded = (exitCode == 0);
+                for(size_t i = 0; i < files.size() && succeeded; i++)
+                    succeeded = MoveBatchOutputs(batchDir, files[i]);
 
-        for(std::string item : mLinkerIncludeDirectories)
-            command.push_back("-L" + item);
+                if(succeeded)
+                {
+                    // Warnings, printed in one piece so they don't mix with other output
+                    std::string output;
+                    if(ReadWholeFile(batchDir + "/output", output) && !output.empty())
+                        std::cout << output << std::flush;
+
+                    // The run's time is shared out, memory stays the peak of the whole run
+                    stats.wallSeconds /= files.size();
+                    stats.cpuSeconds /= files.size();
+                    for(size_t index : indices)
+                    {
+                        RecordCompileStats(mSourceRecords[index], stats);
+                        results[index] = JobResult::Succeeded;
+                        finish(index);
+                    }
+                }
+                else
+                {
+                    // Compiled again one by one, so errors are reported for the source causing them
+                    for(size_t i = 0; i < files.size(); i++)
+                        submitSingle(files[i], indices[i]);
+                }
 
-        for(std::string item : objectFiles)
-            command.push_back(item);
+                std::filesystem::remove_all(batchDir, error);
+            });
+        };
 
-        for(std::string item : mLinkerLibraries)
-            command.push_back("-l" + item);
+        auto compile = [&](const std::string& file) {
+            // Fail-fast stopped the build, without a record the next build still sees the source as changed
+            if(jobPool.IsCancelled())
+            {
+                mDependencyState.RemoveSource(file);
+                return;
+            }
 
-        std::cout << "Linking final executable\n";
-        command.push_back("-o");
-        command.push_back("bin/" + outFileName);
+            // One write per line, builds of other configurations may print at the same time
+            std::cout << ("Compiling: " + file + " > " + GetObjectPath(file) + "\n");
+            compiledFiles.push_back(file);
 
-        Utils::StartProcessAndWait("g++", command);
-        std::cout << "Saved final executable: \"" << outFileName << "\"\n";
-    }
+            size_t index = recordIndices[file];
+            {
+                std::lock_guard<std::mutex> lock(finishedMutex);
+                pendingJobs++;
+            }
 
+            // A batch can't hold two sources whose objects would get the same name
+            if(!UsesSingleCompiles() && mBatchSources.count(file) != 0 && mSourcePools.count(file) == 0)
+            {
+                std::string name = std::filesystem::path(file).stem().string();
+                bool clash = std::any_of(batch.begin(), batch.end(), [&name](const std::string& other) {
+                    return std::filesystem::path(other).stem().string() == name;
+                });
+                if(clash)
+                    submitBatch();
+
+                batch.push_back(file);
+                batchSeconds += mBatchSources[file];
+                if(batch.size() >= mBatchSize || batchSeconds >= MaxBatchSeconds)
+                    submitBatch();
+            }
+            else
+            {
+                submitSingle(file, index);
+            }
 
-    // Compiler class
+            processFinished(false);
+        };
 
-    void Compiler::SetProjectInfo(
-        std::string projectRootDir,
-        std::string projectCacheDir)
-    {
-        switch(mActiveToolchain)
+        // Dirty sources are compiled while the rest is still being checked
+        if(mCleanBuild)
         {
-        case Toolchain::Dummy:
-            mToolchainDummy.SetProjectInfo(projectRootDir, projectCacheDir);
-            break;
-
-        case Toolchain::MinGW:
-            mToolchainMinGW.SetProjectInfo(projectRootDir, projectCacheDir);
-            break;
+            for(const std::string& file : mSourceFiles)
+                compile(file);
         }
-    }
+        else
+        {
+            std::cout << "Checking dependencies...\n";
+            ExamineSources(compile);
+        }
+
+        submitBatch();
+
+        // Handles the compiles still running after the check
+        while(processFinished(true)) {}
+
+        if(!mCleanBuild && compiledFiles.empty())
+            std::cout << "All files are up to date\n";
+
+        for(BuildHistory::SourceRecord& record : mSourceRecords)
+            record.dependencyCount = static_cast<uint32_t>(mDependencies[record.source].size());
+
+        // Remember the stamps this build saw, the next one starts from what differs
+        mDependencyState.SetChangeDetection(mChangeDetection);
+        mDependencyState.RetainSources(mSourceFiles);
+        for(const std::string& path : mDependencyState.GetFiles())
+            mDependencyState.SetFileDigests(path, GetStatCache().GetDigest(GetStatCache().Intern(path)), GetContentDigest(path));
+
+        mDependencyState.Save(statePath);
+        mSystemHeaders.Save(systemHeadersPath);
+
+        // A build sharing the pool may have stopped this one
+        if(failedFiles.empty() && !jobPool.IsCancelled())
+            return true;
+
+        if(failedFiles.empty())
+        {
+            std::cout << "Build stopped by a failure in another build\n";
+        }
+        else if(mKeepGoing)
+        {
+            std::cout << failedFiles.size() << " of " << compiledFiles.size() << " sources failed to compile:\n";
+            for(const std::string& file : failedFiles)
+                std::cout << "    " << file << "\n";
+        }
+        else
+        {
+            size_t notCompiled = std::count(results.begin(), results.end(), JobResult::NotRun)
+                               - (mSourceFiles.size() - compiledFiles.size());
+            std::cout << "Build stopped at the first failure, " << notCompiled << " queued sources were not compiled"
+                      << " (use --keep-going to compile everything possible)\n";
+        }
+
+        return false;
+    }
+
+    bool ToolchainMinGW::Link(std::string outFileName, std::vector<std::string>& objectFiles)
+    {
+        std::vector<std::string> command;
+
+        if(objectFiles.empty())
+        {
+            std::cout << "No object files available to link\n";
+            return false;
+        }
+
+        std::string binaryFile = GetBinaryPath(outFileName);
+        std::string program = mCompilerPath;
+        std::string description = "final executable";
+
+        // Like objects, the output is only replaced by a complete one
+        if(mTargetType == TargetType::StaticLibrary)
+        {
+            // Archives only hold this target's objects, dependencies are linked by whoever uses it
+            program = mArchiverPath;
+            description = "static library " + outFileName;
+            command.push_back("rcs");
+            command.push_back(binaryFile + ".tmp");
+            for(std::string item : objectFiles)
+                command.push_back(item);
+        }
+        else
+        {
+            if(mTargetType == TargetType::SharedLibrary)
+            {
+                description = "shared library " + outFileName;
+                command.push_back("-shared");
+            }
+
+            for(std::string item : mLinkerFlags)
+                command.push_back(item);
+
+            for(std::string item : mLinkerIncludeDirectories)
+                command.push_back("-L" + item);
+
+            // Shared libraries of other targets are found next to the output at run time
+            bool usesSharedLibrary = false;
+            for(std::string item : objectFiles)
+            {
+                command.push_back(item);
+                usesSharedLibrary = usesSharedLibrary || (item.size() > 3 && item.compare(item.size() - 3, 3, ".so") == 0);
+            }
+
+            if(usesSharedLibrary)
+                command.push_back("-Wl,-rpath,$ORIGIN");
+
+            for(std::string item : mLinkerLibraries)
+                command.push_back("-l" + item);
+
+            command.push_back("-o");
+            command.push_back(binaryFile + ".tmp");
+        }
+
+        // Relink only if an input is newer than the output or the link command changed
+        uint64_t linkDigest = Utils::HashString(program, GetCommandDigest(command));
+        uint64_t lastLinkDigest = 0;
+        Utils::FileStamp binaryStamp = GetStatCache().Get(binaryFile);
+        bool upToDate = binaryStamp.exists && ReadLinkDigest(lastLinkDigest) && lastLinkDigest == linkDigest;
+        for(const std::string& item : objectFiles)
+        {
+            Utils::FileStamp objectStamp = GetStatCache().Get(item);
+            if(!upToDate || !objectStamp.exists || objectStamp.modifiedTime > binaryStamp.modifiedTime)
+            {
+                upToDate = false;
+                break;
+            }
+        }
+
+        if(upToDate)
+        {
+            if(mTargetType == TargetType::Executable)
+                std::cout << "Executable is up to date\n";
+            else
+                std::cout << ("Library " + outFileName + " is up to date\n");
+            return true;
+        }
+
+        // A failed link leaves no digest behind, so the next build links again
+        std::filesystem::remove(mProjectCacheDir + "/link");
+
+        // ar adds to an existing archive
+        std::error_code error;
+        std::filesystem::remove(binaryFile + ".tmp", error);
+
+        std::cout << ("Linking " + description + "\n");
+        int exitCode = Utils::StartProcessAndWait(program, command);
+        if(exitCode == 0)
+            std::filesystem::rename(binaryFile + ".tmp", binaryFile, error);
+        else
+            std::filesystem::remove(binaryFile + ".tmp", error);
+
+        GetStatCache().Invalidate(binaryFile);
+        if(exitCode != 0 || error)
+        {
+            std::cout << "ERROR: Toolchain: Failed to link " << outFileName << " ("
+                      << (exitCode != 0 ? "exit code " + std::to_string(exitCode) : "can't replace " + binaryFile) << ")\n";
+            return false;
+        }
+
+        WriteLinkDigest(linkDigest);
+
+        if(mTargetType == TargetType::Executable)
+            std::cout << "Saved final executable: \"" << outFileName << "\"\n";
+        else
+            std::cout << ("Saved library: \"" + binaryFile + "\"\n");
+        return true;
+    }
+
+
+    bool ToolchainMinGW::AnalyzeIncludes(IncludeAnalysis& analysis)
+    {
+        if(mSourceFiles.empty())
+        {
+            std::cout << "ERROR: Toolchain: No source files available\n";
+            return false;
+        }
+
+        // Only the front end runs, what it prints to stderr is kept per source until it is read
+        SetupCompileCommand();
+        std::string outputDir = mProjectCacheDir + "/includes";
+        std::error_code error;
+        std::filesystem::remove_all(outputDir, error);
+        std::filesystem::create_directories(outputDir, error);
+
+        std::unique_ptr<JobPool> ownJobPool;
+        if(mJobPool == nullptr)
+            ownJobPool = std::make_unique<JobPool>(mJobCount);
+        JobPool& jobPool = (mJobPool != nullptr) ? *mJobPool : *ownJobPool;
+
+        // Other builds may share the pool, so this waits for its own jobs only
+        std::vector<int> exitCodes(mSourceFiles.size(), 0);
+        size_t pendingJobs = mSourceFiles.size();
+        std::mutex finishedMutex;
+        std::condition_variable finishedCondition;
+        for(size_t i = 0; i < mSourceFiles.size(); i++)
+        {
+            std::cout << "Analyzing: " << mSourceFiles[i] << "\n";
+            std::vector<std::string> arguments = mCompileCommand;
+            arguments.push_back(mSourceFiles[i]);
+            arguments.push_back("-fsyntax-only");
+            arguments.push_back("-H");
+            arguments.push_back("-ftime-report");
+
+            jobPool.Submit([&, i, arguments]() {
+                if(!jobPool.IsCancelled())
+                    exitCodes[i] = Utils::StartProcessAndWait(mCompilerPath, arguments, nullptr, "", outputDir + "/" + std::to_string(i));
+
+                std::lock_guard<std::mutex> lock(finishedMutex);
+                pendingJobs--;
+                finishedCondition.notify_one();
+            });
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(finishedMutex);
+            finishedCondition.wait(lock, [&]() { return pendingJobs == 0; });
+        }
+
+        bool success = true;
+        for(size_t i = 0; i < mSourceFiles.size(); i++)
+        {
+            std::string outputFile = outputDir + "/" + std::to_string(i);
+            if(exitCodes[i] != 0)
+            {
+                std::cout << "ERROR: Toolchain: Failed to compile " << mSourceFiles[i] << " (exit code " << exitCodes[i]
+                          << "), its output is in " << outputFile << "\n";
+                success = false;
+                continue;
+            }
+
+            std::string output;
+            if(!ReadWholeFile(outputFile, output) || !analysis.AddCompileOutput(mSourceFiles[i], output))
+                std::cout << "WARNING: Toolchain: No -ftime-report output for " << mSourceFiles[i] << "\n";
+            std::filesystem::remove(outputFile, error);
+        }
+
+        return success;
+    }
+
+
+    // Clang toolchain
+
+    void ToolchainClang::SetupCompileCommand()
+    {
+        ToolchainMinGW::SetupCompileCommand();
+
+        // Traces are named after the -o of a single compile, see UsesSingleCompiles(). The flag is part of
+        // the command digests, so switching tracing compiles everything once
+        if(mTimeTrace)
+            mCompileCommand.push_back("-ftime-trace");
+    }
+
+    bool ToolchainClang::Compile(std::vector<std::string>& objectFiles)
+    {
+        if(!mTimeTrace)
+            return ToolchainMinGW::Compile(objectFiles);
+
+        bool success = ToolchainMinGW::Compile(objectFiles);
+
+        // Sources that were up to date still have the trace of their last compile
+        TimeTraceReport report;
+        for(const std::string& objectFile : objectFiles)
+            report.AddTrace(objectFile + ".json");
+
+        if(report.GetTraceCount() == 0)
+        {
+            std::cout << "WARNING: Toolchain: No -ftime-trace files were written, the compiler may be too old\n";
+            return success;
+        }
+
+        std::string reportFile = mProjectCacheDir + "/timetrace.json";
+        report.Display(TimeTraceReportSize);
+        if(report.Save(reportFile))
+            std::cout << "Full report saved to " << reportFile << "\n";
+        return success;
+    }
+
+
+    // Compiler class
+
+    void Compiler::SetProjectInfo(
+        std::string projectRootDir,
+        std::string projectCacheDir)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::Dummy:
+            mToolchainDummy.SetProjectInfo(projectRootDir, projectCacheDir);
+            break;
+
+        case Toolchain::MinGW:
+            mToolchainMinGW.SetProjectInfo(projectRootDir, projectCacheDir);
+            break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetProjectInfo(projectRootDir, projectCacheDir);
+            break;
+        }
+    }
 
     void Compiler::SetSources(
         std::vector<std::string>& sources,
@@ -401,6 +1353,10 @@ namespace Leo
         case Toolchain::MinGW:
             mToolchainMinGW.SetSources(sources, headers);
             break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetSources(sources, headers);
+            break;
         }
     }
 
@@ -418,6 +1374,10 @@ namespace Leo
         case Toolchain::MinGW:
             mToolchainMinGW.SetCompilerOptions(compilerFlags, compilerDefines, compilerIncludeDirectories);
             break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetCompilerOptions(compilerFlags, compilerDefines, compilerIncludeDirectories);
+            break;
         }
     }
 
@@ -435,56 +1395,350 @@ namespace Leo
         case Toolchain::MinGW:
             mToolchainMinGW.SetLinkerOptions(linkerFlags, linkerLibraries, linkerIncludeDirectories);
             break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetLinkerOptions(linkerFlags, linkerLibraries, linkerIncludeDirectories);
+            break;
         }
     }
 
     void Compiler::SetActiveToolchain(Toolchain option)
     {
         mActiveToolchain = option;
+    }
+
+    void Compiler::SetCleanFlag(bool option)
+    {
         switch(mActiveToolchain)
         {
         case Toolchain::Dummy:
-            mToolchainDummy.SetupState();
+            mToolchainDummy.SetCleanFlag(option);
             break;
 
         case Toolchain::MinGW:
-            mToolchainMinGW.SetupState();
+            mToolchainMinGW.SetCleanFlag(option);
+            break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetCleanFlag(option);
             break;
         }
     }
 
-    void Compiler::SetCleanFlag(bool option)
+    void Compiler::SetCompilerPath(std::string compilerPath)
     {
         switch(mActiveToolchain)
         {
         case Toolchain::Dummy:
-            mToolchainDummy.SetCleanFlag(option);
+            mToolchainDummy.SetCompilerPath(compilerPath);
             break;
 
         case Toolchain::MinGW:
-            mToolchainMinGW.SetCleanFlag(option);
+            mToolchainMinGW.SetCompilerPath(compilerPath);
+            break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetCompilerPath(compilerPath);
+            break;
+        }
+    }
+
+    void Compiler::SetBuildDir(std::string buildDir)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::Dummy:
+            mToolchainDummy.SetBuildDir(buildDir);
+            break;
+
+        case Toolchain::MinGW:
+            mToolchainMinGW.SetBuildDir(buildDir);
+            break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetBuildDir(buildDir);
+            break;
+        }
+    }
+
+    void Compiler::SetTarget(std::string name, TargetType type)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::Dummy:
+            mToolchainDummy.SetTarget(name, type);
+            break;
+
+        case Toolchain::MinGW:
+            mToolchainMinGW.SetTarget(name, type);
+            break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetTarget(name, type);
             break;
         }
     }
 
-    std::vector<std::string> Compiler::Compile()
+    void Compiler::SetChangeDetection(ChangeDetection option)
     {
         switch(mActiveToolchain)
         {
         case Toolchain::Dummy:
-            return mToolchainDummy.Compile();
+            mToolchainDummy.SetChangeDetection(option);
             break;
 
         case Toolchain::MinGW:
-            return mToolchainMinGW.Compile();
+            mToolchainMinGW.SetChangeDetection(option);
+            break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetChangeDetection(option);
             break;
         }
+    }
+
+    void Compiler::SetKeepGoing(bool option)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::Dummy:
+            mToolchainDummy.SetKeepGoing(option);
+            break;
+
+        case Toolchain::MinGW:
+            mToolchainMinGW.SetKeepGoing(option);
+            break;
 
-        std::vector<std::string> empty;
-        return empty;
+        case Toolchain::Clang:
+            mToolchainClang.SetKeepGoing(option);
+            break;
+        }
     }
 
-    void Compiler::Link(std::string outFileName, std::vector<std::string>& objectFiles)
+    void Compiler::SetJobPool(JobPool* jobPool)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::Dummy:
+            mToolchainDummy.SetJobPool(jobPool);
+            break;
+
+        case Toolchain::MinGW:
+            mToolchainMinGW.SetJobPool(jobPool);
+            break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetJobPool(jobPool);
+            break;
+        }
+    }
+
+    void Compiler::SetDirectCompile(bool option)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::Dummy:
+            mToolchainDummy.SetDirectCompile(option);
+            break;
+
+        case Toolchain::MinGW:
+            mToolchainMinGW.SetDirectCompile(option);
+            break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetDirectCompile(option);
+            break;
+        }
+    }
+
+    void Compiler::SetToolchainProbe(const ToolchainProbe& probe)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::Dummy:
+            mToolchainDummy.SetToolchainProbe(probe);
+            break;
+
+        case Toolchain::MinGW:
+            mToolchainMinGW.SetToolchainProbe(probe);
+            break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetToolchainProbe(probe);
+            break;
+        }
+    }
+
+    void Compiler::SetTimeTrace(bool option)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::Dummy:
+            mToolchainDummy.SetTimeTrace(option);
+            break;
+
+        case Toolchain::MinGW:
+            mToolchainMinGW.SetTimeTrace(option);
+            break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetTimeTrace(option);
+            break;
+        }
+    }
+
+    void Compiler::SetCompileBatching(size_t maxBatchSize, std::unordered_map<std::string, float> smallSources)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::Dummy:
+            mToolchainDummy.SetCompileBatching(maxBatchSize, smallSources);
+            break;
+
+        case Toolchain::MinGW:
+            mToolchainMinGW.SetCompileBatching(maxBatchSize, smallSources);
+            break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetCompileBatching(maxBatchSize, smallSources);
+            break;
+        }
+    }
+
+    void Compiler::SetResourcePools(std::unordered_map<std::string, size_t> limits, std::unordered_map<std::string, std::string> sourcePools)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::Dummy:
+            mToolchainDummy.SetResourcePools(limits, sourcePools);
+            break;
+
+        case Toolchain::MinGW:
+            mToolchainMinGW.SetResourcePools(limits, sourcePools);
+            break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetResourcePools(limits, sourcePools);
+            break;
+        }
+    }
+
+    void Compiler::SetJobCount(size_t jobCount)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::Dummy:
+            mToolchainDummy.SetJobCount(jobCount);
+            break;
+
+        case Toolchain::MinGW:
+            mToolchainMinGW.SetJobCount(jobCount);
+            break;
+
+        case Toolchain::Clang:
+            mToolchainClang.SetJobCount(jobCount);
+            break;
+        }
+    }
+
+    bool Compiler::Compile(std::vector<std::string>& objectFiles)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::Dummy:
+            return mToolchainDummy.Compile(objectFiles);
+            break;
+
+        case Toolchain::MinGW:
+            return mToolchainMinGW.Compile(objectFiles);
+            break;
+
+        case Toolchain::Clang:
+            return mToolchainClang.Compile(objectFiles);
+            break;
+        }
+
+        return false;
+    }
+
+    bool Compiler::AnalyzeIncludes(IncludeAnalysis& analysis)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::Dummy:
+            return mToolchainDummy.AnalyzeIncludes(analysis);
+
+        case Toolchain::MinGW:
+            return mToolchainMinGW.AnalyzeIncludes(analysis);
+
+        case Toolchain::Clang:
+            return mToolchainClang.AnalyzeIncludes(analysis);
+        }
+
+        return false;
+    }
+
+    std::vector<BuildHistory::SourceRecord>& Compiler::GetSourceRecords()
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::MinGW:
+            return mToolchainMinGW.GetSourceRecords();
+
+        case Toolchain::Clang:
+            return mToolchainClang.GetSourceRecords();
+
+        default:
+            return mToolchainDummy.GetSourceRecords();
+        }
+    }
+
+    std::unordered_map<std::string, std::vector<std::string>>& Compiler::GetDependencies()
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::MinGW:
+            return mToolchainMinGW.GetDependencies();
+
+        case Toolchain::Clang:
+            return mToolchainClang.GetDependencies();
+
+        default:
+            return mToolchainDummy.GetDependencies();
+        }
+    }
+
+    std::string Compiler::GetObjectPath(const std::string& source)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::MinGW:
+            return mToolchainMinGW.GetObjectPath(source);
+
+        case Toolchain::Clang:
+            return mToolchainClang.GetObjectPath(source);
+
+        default:
+            return mToolchainDummy.GetObjectPath(source);
+        }
+    }
+
+    std::string Compiler::GetBinaryPath(const std::string& outFileName)
+    {
+        switch(mActiveToolchain)
+        {
+        case Toolchain::MinGW:
+            return mToolchainMinGW.GetBinaryPath(outFileName);
+
+        case Toolchain::Clang:
+            return mToolchainClang.GetBinaryPath(outFileName);
+
+        default:
+            return mToolchainDummy.GetBinaryPath(outFileName);
+        }
+    }
+
+    bool Compiler::Link(std::string outFileName, std::vector<std::string>& objectFiles)
     {
         switch(mActiveToolchain)
         {
@@ -495,6 +1749,12 @@ namespace Leo
         case Toolchain::MinGW:
             return mToolchainMinGW.Link(outFileName, objectFiles);
             break;
+
+        case Toolchain::Clang:
+            return mToolchainClang.Link(outFileName, objectFiles);
+            break;
         }
+
+        return false;
     }
 }
\ No newline at end of file
@@ -0,0 +1,427 @@
+#include "DependencyState.hpp"
+#include "Utils.hpp"
+
+#include <sstream>
+#include <algorithm>
+#include <unordered_set>
+
+static const uint32_t stateMagic = 0x444f454c; // "LEOD"
+static const uint32_t stateVersion = 4;
+static const uint32_t journalMagic = 0x4a4f454c; // "LEOJ"
+static const uint32_t journalVersion = 1;
+
+// Sources and headers of a snapshot, far beyond any real project
+static const uint32_t maxSnapshotPaths = 1 << 22;
+
+// Same file spelled differently, e.g. "./include/a.hpp" and "/home/me/project/include/a.hpp"
+static std::string MakeComparablePath(const std::string& path)
+{
+    std::filesystem::path result = std::filesystem::path(Utils::NormalizePath(path)).lexically_normal();
+    if(result.is_absolute())
+    {
+        std::filesystem::path relative = result.lexically_relative(std::filesystem::current_path());
+        if(!relative.empty() && *relative.begin() != "..")
+            result = relative;
+    }
+    return result.generic_string();
+}
+
+namespace Leo
+{
+    bool DependencyState::Load(std::string filepath)
+    {
+        *this = DependencyState();
+
+        // Sources finished by an interrupted build are only in the journal
+        bool loaded = LoadSnapshot(filepath);
+        if(!loaded)
+            *this = DependencyState();
+
+        return ReplayJournal(filepath + ".journal") || loaded;
+    }
+
+    bool DependencyState::LoadSnapshot(std::string filepath)
+    {
+        std::ifstream file(filepath, std::ios::binary);
+        if(!file.is_open())
+            return false;
+
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        uint32_t changeDetection = 0;
+        uint32_t pathCount = 0;
+        uint32_t sourceCount = 0;
+        Utils::ReadBinary(file, magic);
+        Utils::ReadBinary(file, version);
+        if(magic != stateMagic || version != stateVersion)
+            return false;
+
+        Utils::ReadBinary(file, changeDetection);
+        mChangeDetection = static_cast<ChangeDetection>(changeDetection);
+
+        // A corrupt count must not turn into a huge allocation either
+        if(!Utils::ReadBinary(file, pathCount) || pathCount > maxSnapshotPaths)
+            return false;
+
+        std::vector<std::string> paths(pathCount);
+        std::vector<FileEntry> files(pathCount);
+        for(uint32_t i = 0; i < pathCount && file; i++)
+        {
+            Utils::ReadBinary(file, paths[i]);
+            Utils::ReadBinary(file, files[i].stampDigest);
+            Utils::ReadBinary(file, files[i].contentDigest);
+        }
+
+        Utils::ReadBinary(file, sourceCount);
+        for(uint32_t i = 0; i < sourceCount && file; i++)
+        {
+            uint32_t sourceIndex = 0;
+            uint64_t digest = 0;
+            uint64_t commandDigest = 0;
+            uint32_t depCount = 0;
+            Utils::ReadBinary(file, sourceIndex);
+            Utils::ReadBinary(file, digest);
+            Utils::ReadBinary(file, commandDigest);
+            Utils::ReadBinary(file, depCount);
+
+            std::vector<std::string> deps;
+            for(uint32_t j = 0; j < depCount && file; j++)
+            {
+                uint32_t depIndex = 0;
+                Utils::ReadBinary(file, depIndex);
+                if(depIndex < pathCount)
+                    deps.push_back(paths[depIndex]);
+            }
+
+            if(sourceIndex < pathCount)
+                SetSource(paths[sourceIndex], digest, commandDigest, deps);
+        }
+
+        // Half a file could make stale sources look up to date
+        if(!file)
+            return false;
+
+        for(uint32_t i = 0; i < pathCount; i++)
+            SetFileDigests(paths[i], files[i].stampDigest, files[i].contentDigest);
+
+        return true;
+    }
+
+    bool DependencyState::Save(std::string filepath)
+    {
+        // Only paths some recorded source still refers to are written
+        std::vector<int64_t> remap(mPaths.size(), -1);
+        std::vector<uint32_t> usedPaths;
+        auto use = [&](uint32_t index) {
+            if(remap[index] < 0)
+            {
+                remap[index] = static_cast<int64_t>(usedPaths.size());
+                usedPaths.push_back(index);
+            }
+            return static_cast<uint32_t>(remap[index]);
+        };
+
+        for(const auto& [sourceIndex, entry] : mSources)
+        {
+            use(sourceIndex);
+            for(uint32_t depIndex : entry.deps)
+                use(depIndex);
+        }
+
+        std::string tmpPath = filepath + ".tmp";
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!file.is_open())
+            return false;
+
+        Utils::WriteBinary(file, stateMagic);
+        Utils::WriteBinary(file, stateVersion);
+        Utils::WriteBinary(file, static_cast<uint32_t>(mChangeDetection));
+        Utils::WriteBinary(file, static_cast<uint32_t>(usedPaths.size()));
+        for(uint32_t index : usedPaths)
+        {
+            Utils::WriteBinary(file, mPaths[index]);
+            Utils::WriteBinary(file, mFiles[index].stampDigest);
+            Utils::WriteBinary(file, mFiles[index].contentDigest);
+        }
+
+        Utils::WriteBinary(file, static_cast<uint32_t>(mSources.size()));
+        for(const auto& [sourceIndex, entry] : mSources)
+        {
+            Utils::WriteBinary(file, use(sourceIndex));
+            Utils::WriteBinary(file, entry.digest);
+            Utils::WriteBinary(file, entry.commandDigest);
+            Utils::WriteBinary(file, static_cast<uint32_t>(entry.deps.size()));
+            for(uint32_t depIndex : entry.deps)
+                Utils::WriteBinary(file, use(depIndex));
+        }
+        file.close();
+
+        std::error_code error;
+        std::filesystem::rename(tmpPath, filepath, error);
+        if(error)
+            return false;
+
+        // Everything in the journal is part of the file now
+        if(mJournal.is_open())
+            mJournal.close();
+        std::filesystem::remove(filepath + ".journal", error);
+        mReplayedCount = 0;
+        return true;
+    }
+
+    bool DependencyState::OpenJournal(std::string filepath)
+    {
+        // Records replayed by Load() would be lost with the old journal
+        if(mReplayedCount > 0 && !Save(filepath))
+            return false;
+
+        mJournal.close();
+        mJournal.open(filepath + ".journal", std::ios::binary | std::ios::trunc);
+        if(!mJournal.is_open())
+            return false;
+
+        Utils::WriteBinary(mJournal, journalMagic);
+        Utils::WriteBinary(mJournal, journalVersion);
+        Utils::WriteBinary(mJournal, static_cast<uint32_t>(mChangeDetection));
+        mJournal.flush();
+        return static_cast<bool>(mJournal);
+    }
+
+    bool DependencyState::AppendToJournal(const std::string& source)
+    {
+        auto pathIt = mPathIndices.find(source);
+        if(!mJournal.is_open() || pathIt == mPathIndices.end())
+            return false;
+
+        auto it = mSources.find(pathIt->second);
+        if(it == mSources.end())
+            return false;
+
+        std::ostringstream record;
+        Utils::WriteBinary(record, source);
+        Utils::WriteBinary(record, it->second.digest);
+        Utils::WriteBinary(record, it->second.commandDigest);
+        Utils::WriteBinary(record, static_cast<uint32_t>(it->second.deps.size()));
+        for(uint32_t depIndex : it->second.deps)
+            Utils::WriteBinary(record, mPaths[depIndex]);
+
+        // Written and flushed as one piece, a killed build leaves at most the last record torn
+        std::string data = record.str();
+        Utils::WriteBinary(mJournal, data);
+        Utils::WriteBinary(mJournal, Utils::HashString(data));
+        mJournal.flush();
+        return static_cast<bool>(mJournal);
+    }
+
+    bool DependencyState::ReplayJournal(std::string filepath)
+    {
+        std::ifstream file(filepath, std::ios::binary);
+        if(!file.is_open())
+            return false;
+
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        uint32_t changeDetection = 0;
+        Utils::ReadBinary(file, magic);
+        Utils::ReadBinary(file, version);
+        Utils::ReadBinary(file, changeDetection);
+        if(!file || magic != journalMagic || version != journalVersion)
+            return false;
+
+        // Records of another mode can't be mixed with the loaded ones
+        if(mSources.empty())
+            mChangeDetection = static_cast<ChangeDetection>(changeDetection);
+        else if(static_cast<uint32_t>(mChangeDetection) != changeDetection)
+            return false;
+
+        // A torn length must not turn into a huge allocation
+        const uint32_t maxRecordSize = 64 << 20;
+        std::string data;
+        uint32_t size = 0;
+        uint64_t checksum = 0;
+        while(Utils::ReadBinary(file, size) && size <= maxRecordSize)
+        {
+            data.resize(size);
+            file.read(data.data(), size);
+            if(!Utils::ReadBinary(file, checksum) || Utils::HashString(data) != checksum)
+                break;
+
+            std::istringstream record(data);
+            std::string source;
+            uint64_t digest = 0;
+            uint64_t commandDigest = 0;
+            uint32_t depCount = 0;
+            Utils::ReadBinary(record, source);
+            Utils::ReadBinary(record, digest);
+            Utils::ReadBinary(record, commandDigest);
+            Utils::ReadBinary(record, depCount);
+
+            std::vector<std::string> deps(depCount);
+            for(uint32_t i = 0; i < depCount && record; i++)
+                Utils::ReadBinary(record, deps[i]);
+
+            if(!record)
+                break;
+
+            SetSource(source, digest, commandDigest, deps);
+            mReplayedCount++;
+        }
+
+        return mReplayedCount > 0;
+    }
+
+    bool DependencyState::GetSource(const std::string& source, uint64_t& digestOut, uint64_t& commandDigestOut, std::vector<std::string>& depsOut) const
+    {
+        auto pathIt = mPathIndices.find(source);
+        if(pathIt == mPathIndices.end())
+            return false;
+
+        auto it = mSources.find(pathIt->second);
+        if(it == mSources.end())
+            return false;
+
+        digestOut = it->second.digest;
+        commandDigestOut = it->second.commandDigest;
+        depsOut.clear();
+        for(uint32_t depIndex : it->second.deps)
+            depsOut.push_back(mPaths[depIndex]);
+
+        return true;
+    }
+
+    void DependencyState::SetSource(const std::string& source, uint64_t digest, uint64_t commandDigest, const std::vector<std::string>& deps)
+    {
+        RemoveSource(source);
+
+        uint32_t sourceIndex = GetPathIndex(source);
+        SourceEntry& entry = mSources[sourceIndex];
+        entry.digest = digest;
+        entry.commandDigest = commandDigest;
+
+        // A source depends on itself, so editing it shows up like editing a header
+        mDependents[sourceIndex].push_back(sourceIndex);
+        for(const std::string& dep : deps)
+        {
+            uint32_t depIndex = GetPathIndex(dep);
+            entry.deps.push_back(depIndex);
+            mDependents[depIndex].push_back(sourceIndex);
+        }
+    }
+
+    void DependencyState::RemoveSource(const std::string& source)
+    {
+        auto pathIt = mPathIndices.find(source);
+        if(pathIt == mPathIndices.end())
+            return;
+
+        uint32_t sourceIndex = pathIt->second;
+        auto it = mSources.find(sourceIndex);
+        if(it == mSources.end())
+            return;
+
+        auto unlink = [&](uint32_t index) {
+            std::vector<uint32_t>& dependents = mDependents[index];
+            dependents.erase(std::remove(dependents.begin(), dependents.end(), sourceIndex), dependents.end());
+        };
+
+        unlink(sourceIndex);
+        for(uint32_t depIndex : it->second.deps)
+            unlink(depIndex);
+
+        mSources.erase(it);
+    }
+
+    ChangeDetection DependencyState::GetChangeDetection() const
+    {
+        return mChangeDetection;
+    }
+
+    void DependencyState::SetChangeDetection(ChangeDetection option)
+    {
+        mChangeDetection = option;
+    }
+
+    void DependencyState::RetainSources(const std::vector<std::string>& sources)
+    {
+        std::unordered_set<std::string> keep(sources.begin(), sources.end());
+
+        std::vector<std::string> removed;
+        for(const auto& [sourceIndex, entry] : mSources)
+        {
+            if(keep.count(mPaths[sourceIndex]) == 0)
+                removed.push_back(mPaths[sourceIndex]);
+        }
+
+        for(const std::string& source : removed)
+            RemoveSource(source);
+    }
+
+    std::vector<std::string> DependencyState::GetFiles() const
+    {
+        std::vector<std::string> files;
+        for(size_t i = 0; i < mPaths.size(); i++)
+        {
+            if(!mDependents[i].empty())
+                files.push_back(mPaths[i]);
+        }
+        return files;
+    }
+
+    bool DependencyState::GetFileDigests(const std::string& path, uint64_t& stampDigestOut, uint64_t& contentDigestOut) const
+    {
+        auto it = mPathIndices.find(path);
+        if(it == mPathIndices.end() || mFiles[it->second].stampDigest == 0)
+            return false;
+
+        stampDigestOut = mFiles[it->second].stampDigest;
+        contentDigestOut = mFiles[it->second].contentDigest;
+        return true;
+    }
+
+    void DependencyState::SetFileDigests(const std::string& path, uint64_t stampDigest, uint64_t contentDigest)
+    {
+        FileEntry& entry = mFiles[GetPathIndex(path)];
+        entry.stampDigest = stampDigest;
+        entry.contentDigest = contentDigest;
+    }
+
+    std::vector<std::string> DependencyState::GetDependents(const std::string& path) const
+    {
+        std::vector<std::string> sources;
+        int64_t index = FindPathIndex(path);
+        if(index < 0)
+            return sources;
+
+        for(uint32_t sourceIndex : mDependents[index])
+            sources.push_back(mPaths[sourceIndex]);
+        return sources;
+    }
+
+    uint32_t DependencyState::GetPathIndex(const std::string& path)
+    {
+        auto [it, inserted] = mPathIndices.emplace(path, static_cast<uint32_t>(mPaths.size()));
+        if(inserted)
+        {
+            mPaths.push_back(path);
+            mFiles.emplace_back();
+            mDependents.emplace_back();
+        }
+        return it->second;
+    }
+
+    int64_t DependencyState::FindPathIndex(const std::string& path) const
+    {
+        auto it = mPathIndices.find(path);
+        if(it != mPathIndices.end())
+            return it->second;
+
+        // Only queries from the command line end up here, a linear search is fine
+        std::string comparablePath = MakeComparablePath(path);
+        for(size_t i = 0; i < mPaths.size(); i++)
+        {
+            if(MakeComparablePath(mPaths[i]) == comparablePath)
+                return static_cast<int64_t>(i);
+        }
+        return -1;
+    }
+}
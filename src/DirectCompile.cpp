@@ -0,0 +1,347 @@
+#include "DirectCompile.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+static const uint32_t directCompileMagic = 0x44454f4c; // "LEOD"
+static const uint32_t directCompileVersion = 1;
+
+// Paths replaced by the first few substitutions may appear anywhere in an argument,
+// file names and the object directory only count as whole arguments
+static const size_t substringSubstitutions = 4;
+
+// Commands of a plan, arguments of a command and so on, a corrupt count must not turn into a huge allocation
+static const uint32_t maxPlanEntries = 1 << 16;
+
+static bool ReadCount(std::istream& in, uint32_t& countOut)
+{
+    if(Utils::ReadBinary(in, countOut) && countOut <= maxPlanEntries)
+        return true;
+
+    in.setstate(std::ios::failbit);
+    return false;
+}
+
+static std::string GetMarker(size_t index)
+{
+    return std::string("\x1b") + static_cast<char>('0' + index);
+}
+
+static void ReplaceAll(std::string& text, const std::string& from, const std::string& to)
+{
+    if(from.empty())
+        return;
+
+    for(size_t position = text.find(from); position != std::string::npos; position = text.find(from, position + to.length()))
+        text.replace(position, from.length(), to);
+}
+
+static std::string Abstract(std::string argument, const std::vector<std::string>& substitutions)
+{
+    for(size_t i = 0; i < substitutions.size(); i++)
+    {
+        if(i < substringSubstitutions)
+            ReplaceAll(argument, substitutions[i], GetMarker(i));
+        else if(!substitutions[i].empty() && argument == substitutions[i])
+            return GetMarker(i);
+    }
+    return argument;
+}
+
+static std::string Expand(std::string argument, const std::vector<std::string>& substitutions)
+{
+    for(size_t i = 0; i < substitutions.size(); i++)
+        ReplaceAll(argument, GetMarker(i), substitutions[i]);
+    return argument;
+}
+
+// Commands printed by -###, indented by a space. Arguments with special characters are in double quotes
+static bool ParseCommand(const std::string& line, std::vector<std::string>& argumentsOut)
+{
+    if(line.length() < 2 || line[0] != ' ' || line[1] == ' ')
+        return false;
+
+    argumentsOut.clear();
+    size_t i = 1;
+    while(i < line.length())
+    {
+        if(line[i] == ' ')
+        {
+            i++;
+            continue;
+        }
+
+        std::string argument;
+        if(line[i] == '"')
+        {
+            for(i++; i < line.length() && line[i] != '"'; i++)
+            {
+                if(line[i] == '\\' && i + 1 < line.length())
+                    i++;
+                argument += line[i];
+            }
+
+            if(i >= line.length())
+                return false;
+            i++;
+        }
+        else
+        {
+            for(; i < line.length() && line[i] != ' '; i++)
+                argument += line[i];
+        }
+        argumentsOut.push_back(argument);
+    }
+    return !argumentsOut.empty();
+}
+
+namespace Leo
+{
+    bool DirectCompileCache::Load(std::string filepath)
+    {
+        mPlans.clear();
+        mProbeFile = filepath + ".probe";
+
+        std::ifstream file(filepath, std::ios::binary);
+        if(!file.is_open())
+            return false;
+
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        uint32_t planCount = 0;
+        Utils::ReadBinary(file, magic);
+        Utils::ReadBinary(file, version);
+        if(magic != directCompileMagic || version != directCompileVersion)
+            return false;
+
+        Utils::ReadBinary(file, planCount);
+        for(uint32_t i = 0; i < planCount && file; i++)
+        {
+            uint64_t key = 0;
+            Plan plan;
+            uint32_t commandCount = 0;
+            uint32_t intermediateCount = 0;
+            uint32_t programCount = 0;
+
+            if(!Utils::ReadBinary(file, key) || !ReadCount(file, commandCount))
+                break;
+
+            plan.commands.resize(commandCount);
+            for(size_t j = 0; j < plan.commands.size() && file; j++)
+            {
+                uint32_t argumentCount = 0;
+                if(!ReadCount(file, argumentCount))
+                    break;
+
+                plan.commands[j].resize(argumentCount);
+                for(std::string& argument : plan.commands[j])
+                {
+                    if(!Utils::ReadBinary(file, argument))
+                        break;
+                }
+            }
+
+            if(!file || !ReadCount(file, intermediateCount))
+                break;
+
+            plan.intermediates.resize(intermediateCount);
+            for(std::string& intermediate : plan.intermediates)
+            {
+                if(!Utils::ReadBinary(file, intermediate))
+                    break;
+            }
+
+            if(!file || !ReadCount(file, programCount))
+                break;
+
+            plan.programs.resize(programCount);
+            plan.stamps.resize(programCount);
+            for(uint32_t j = 0; j < programCount && file; j++)
+            {
+                Utils::ReadBinary(file, plan.programs[j]);
+                Utils::ReadBinary(file, plan.stamps[j].modifiedTime);
+                Utils::ReadBinary(file, plan.stamps[j].size);
+                plan.stamps[j].exists = true;
+            }
+
+            // An updated compiler may start other programs with other arguments
+            bool current = true;
+            for(size_t j = 0; j < plan.programs.size() && current; j++)
+                current = (Utils::GetFileStamp(plan.programs[j]) == plan.stamps[j]);
+
+            if(file && current)
+                mPlans[key] = std::move(plan);
+        }
+
+        return static_cast<bool>(file);
+    }
+
+    bool DirectCompileCache::Save(std::string filepath)
+    {
+        std::string tmpPath = filepath + ".tmp";
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!file.is_open())
+            return false;
+
+        Utils::WriteBinary(file, directCompileMagic);
+        Utils::WriteBinary(file, directCompileVersion);
+        Utils::WriteBinary(file, static_cast<uint32_t>(mPlans.size()));
+        for(const auto& [key, plan] : mPlans)
+        {
+            Utils::WriteBinary(file, key);
+            Utils::WriteBinary(file, static_cast<uint32_t>(plan.commands.size()));
+            for(const std::vector<std::string>& command : plan.commands)
+            {
+                Utils::WriteBinary(file, static_cast<uint32_t>(command.size()));
+                for(const std::string& argument : command)
+                    Utils::WriteBinary(file, argument);
+            }
+
+            Utils::WriteBinary(file, static_cast<uint32_t>(plan.intermediates.size()));
+            for(const std::string& intermediate : plan.intermediates)
+                Utils::WriteBinary(file, intermediate);
+
+            Utils::WriteBinary(file, static_cast<uint32_t>(plan.programs.size()));
+            for(size_t i = 0; i < plan.programs.size(); i++)
+            {
+                Utils::WriteBinary(file, plan.programs[i]);
+                Utils::WriteBinary(file, plan.stamps[i].modifiedTime);
+                Utils::WriteBinary(file, plan.stamps[i].size);
+            }
+        }
+        file.close();
+
+        std::error_code error;
+        std::filesystem::rename(tmpPath, filepath, error);
+        return !error;
+    }
+
+    bool DirectCompileCache::Prepare(const std::string& compilerPath, const std::vector<std::string>& arguments, const std::string& source,
+                                     const std::string& objectFile, const std::string& dependencyFile)
+    {
+        std::vector<std::string> substitutions = GetSubstitutions(source, objectFile, dependencyFile);
+        uint64_t key = GetKey(compilerPath, arguments, substitutions);
+        auto known = mPlans.find(key);
+        if(known != mPlans.end())
+            return !known->second.commands.empty();
+
+        // Without the driver's path its updates would go unnoticed, nothing is remembered then
+        std::string driver = Utils::FindProgram(compilerPath);
+        if(driver.empty())
+            return false;
+
+        // An unusable plan is kept as well, so the driver isn't asked again by every build
+        Plan& plan = mPlans[key];
+        plan.programs.push_back(driver);
+        plan.stamps.push_back(Utils::GetFileStamp(driver));
+
+        std::vector<std::string> probeArguments = arguments;
+        probeArguments.push_back("-###");
+        std::string output;
+        if(Utils::StartProcessAndWait(compilerPath, probeArguments, nullptr, "", mProbeFile) == 0)
+        {
+            std::ifstream file(mProbeFile, std::ios::binary);
+            std::stringstream buffer;
+            buffer << file.rdbuf();
+            output = buffer.str();
+        }
+
+        std::error_code error;
+        std::filesystem::remove(mProbeFile, error);
+
+        std::vector<std::vector<std::string>> commands;
+        std::istringstream lines(output);
+        std::string line;
+        while(std::getline(lines, line))
+        {
+            if(!line.empty() && line.back() == '\r')
+                line.pop_back();
+
+            std::vector<std::string> command;
+            if(ParseCommand(line, command))
+                commands.push_back(command);
+        }
+
+        // Outputs of all but the last command are temporary files the driver names at random
+        std::vector<std::string> intermediates;
+        for(size_t i = 0; i + 1 < commands.size(); i++)
+        {
+            for(size_t j = 0; j + 1 < commands[i].size(); j++)
+            {
+                if(commands[i][j] != "-o" || Abstract(commands[i][j + 1], substitutions) != commands[i][j + 1])
+                    continue;
+
+                std::string temporary = commands[i][j + 1];
+                std::string replacement = GetMarker(1) + "." + std::to_string(intermediates.size())
+                                        + std::filesystem::path(temporary).extension().string();
+                for(std::vector<std::string>& command : commands)
+                    std::replace(command.begin(), command.end(), temporary, replacement);
+                intermediates.push_back(replacement);
+            }
+        }
+
+        for(std::vector<std::string>& command : commands)
+        {
+            std::string program = Utils::FindProgram(command[0]);
+            if(program.empty())
+                return false;
+            plan.programs.push_back(program);
+            plan.stamps.push_back(Utils::GetFileStamp(program));
+
+            for(size_t i = 1; i < command.size(); i++)
+                command[i] = Abstract(command[i], substitutions);
+        }
+
+        plan.commands = commands;
+        plan.intermediates = intermediates;
+        return !plan.commands.empty();
+    }
+
+    bool DirectCompileCache::GetCommands(const std::string& compilerPath, const std::vector<std::string>& arguments, const std::string& source,
+                                         const std::string& objectFile, const std::string& dependencyFile,
+                                         std::vector<std::vector<std::string>>& commandsOut, std::vector<std::string>& intermediatesOut) const
+    {
+        std::vector<std::string> substitutions = GetSubstitutions(source, objectFile, dependencyFile);
+        auto plan = mPlans.find(GetKey(compilerPath, arguments, substitutions));
+        if(plan == mPlans.end() || plan->second.commands.empty())
+            return false;
+
+        commandsOut.clear();
+        for(const std::vector<std::string>& command : plan->second.commands)
+        {
+            commandsOut.emplace_back();
+            for(const std::string& argument : command)
+                commandsOut.back().push_back(Expand(argument, substitutions));
+        }
+
+        intermediatesOut.clear();
+        for(const std::string& intermediate : plan->second.intermediates)
+            intermediatesOut.push_back(Expand(intermediate, substitutions));
+        return true;
+    }
+
+    std::vector<std::string> DirectCompileCache::GetSubstitutions(const std::string& source, const std::string& objectFile,
+                                                                  const std::string& dependencyFile)
+    {
+        // GCC derives names of auxiliary outputs (-dumpbase, -dumpdir) from the object's and the source's name
+        std::filesystem::path sourcePath(source);
+        std::filesystem::path objectPath(objectFile);
+        std::string objectDir = objectPath.parent_path().generic_string();
+        return { dependencyFile, objectFile, source, objectPath.stem().string(), objectDir.empty() ? "" : objectDir + "/",
+                 sourcePath.filename().string(), sourcePath.stem().string() };
+    }
+
+    uint64_t DirectCompileCache::GetKey(const std::string& compilerPath, const std::vector<std::string>& arguments,
+                                        const std::vector<std::string>& substitutions)
+    {
+        // Sources of one extension and one flag set share a plan
+        uint64_t key = Utils::HashString(compilerPath);
+        key = Utils::HashString(std::filesystem::path(substitutions[2]).extension().string(), key);
+        for(const std::string& argument : arguments)
+        {
+            std::string abstracted = Abstract(argument, substitutions);
+            key = Utils::HashString(abstracted, Utils::HashValue(abstracted.size(), key));
+        }
+        return key;
+    }
+}
@@ -0,0 +1,465 @@
+#include "FileService.hpp"
+
+#include <thread>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <functional>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define LEO_HAS_IO_URING 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+namespace
+{
+    // Runs 'body' over [0, count) split into ranges on several threads
+    void ParallelFor(size_t count, size_t itemsPerThread, const std::function<void(size_t, size_t)>& body)
+    {
+        size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                              (count + itemsPerThread - 1) / itemsPerThread);
+        if(threadCount <= 1)
+        {
+            body(0, count);
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        size_t chunk = (count + threadCount - 1) / threadCount;
+        for(size_t begin = 0; begin < count; begin += chunk)
+            threads.emplace_back(body, begin, std::min(begin + chunk, count));
+
+        for(std::thread& thread : threads)
+            thread.join();
+    }
+}
+
+namespace Leo
+{
+#ifdef LEO_HAS_IO_URING
+
+    // Minimal io_uring driver on top of the raw system calls
+    struct FileService::Ring
+    {
+        static constexpr unsigned Entries = 256;
+
+        int fd = -1;
+
+        void* sqPtr = MAP_FAILED;
+        size_t sqSize = 0;
+        unsigned* sqHead = nullptr;
+        unsigned* sqTail = nullptr;
+        unsigned* sqMask = nullptr;
+        unsigned* sqArray = nullptr;
+        unsigned sqEntries = 0;
+
+        io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        size_t sqesSize = 0;
+
+        void* cqPtr = MAP_FAILED;
+        size_t cqSize = 0;
+        unsigned* cqHead = nullptr;
+        unsigned* cqTail = nullptr;
+        unsigned* cqMask = nullptr;
+        io_uring_cqe* cqes = nullptr;
+
+        bool Setup()
+        {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            fd = static_cast<int>(syscall(__NR_io_uring_setup, Entries, &params));
+            if(fd < 0)
+                return false;
+
+            sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if(singleMap)
+                sqSize = cqSize = std::max(sqSize, cqSize);
+
+            sqPtr = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            if(sqPtr == MAP_FAILED)
+                return false;
+
+            cqPtr = singleMap ? sqPtr
+                              : mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+            if(cqPtr == MAP_FAILED)
+                return false;
+
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+            if(sqes == MAP_FAILED)
+                return false;
+
+            char* sq = static_cast<char*>(sqPtr);
+            sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            sqEntries = params.sq_entries;
+
+            char* cq = static_cast<char*>(cqPtr);
+            cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+            return SupportsOperations({ IORING_OP_STATX, IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE });
+        }
+
+        // Older kernels have io_uring but not every operation we need
+        bool SupportsOperations(std::initializer_list<int> operations)
+        {
+            const unsigned operationCount = 256;
+            std::vector<char> buffer(sizeof(io_uring_probe) + operationCount * sizeof(io_uring_probe_op), 0);
+            io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+            if(syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, operationCount) < 0)
+                return false;
+
+            for(int operation : operations)
+            {
+                if(operation > probe->last_op || !(probe->ops[operation].flags & IO_URING_OP_SUPPORTED))
+                    return false;
+            }
+
+            return true;
+        }
+
+        ~Ring()
+        {
+            if(sqes != MAP_FAILED) munmap(sqes, sqesSize);
+            if(cqPtr != MAP_FAILED && cqPtr != sqPtr) munmap(cqPtr, cqSize);
+            if(sqPtr != MAP_FAILED) munmap(sqPtr, sqSize);
+            if(fd >= 0) close(fd);
+        }
+
+        // Submits 'count' operations prepared by 'prepare' and hands every result to 'complete'.
+        // Keeps at most a ring worth of operations in flight
+        bool Run(size_t count,
+                 const std::function<void(io_uring_sqe*, size_t)>& prepare,
+                 const std::function<void(size_t, int)>& complete)
+        {
+            size_t prepared = 0;
+            size_t completed = 0;
+            unsigned pending = 0;
+
+            while(completed < count)
+            {
+                unsigned tail = *sqTail;
+                unsigned inFlight = static_cast<unsigned>(prepared - completed);
+                while(prepared < count && inFlight < sqEntries)
+                {
+                    unsigned index = tail & *sqMask;
+                    io_uring_sqe* sqe = &sqes[index];
+                    std::memset(sqe, 0, sizeof(*sqe));
+                    prepare(sqe, prepared);
+                    sqe->user_data = prepared;
+                    sqArray[index] = index;
+
+                    tail++;
+                    prepared++;
+                    pending++;
+                    inFlight++;
+                }
+                __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+
+                int submitted = static_cast<int>(syscall(__NR_io_uring_enter, fd, pending, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+                if(submitted < 0)
+                {
+                    // Busy rings free up once we reap what already completed
+                    if(errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                    {
+                        Drain(prepared - pending - completed, complete);
+                        return false;
+                    }
+                    submitted = 0;
+                }
+                pending -= static_cast<unsigned>(submitted);
+
+                unsigned head = *cqHead;
+                unsigned cqTailValue = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+                while(head != cqTailValue)
+                {
+                    io_uring_cqe* cqe = &cqes[head & *cqMask];
+                    complete(static_cast<size_t>(cqe->user_data), cqe->res);
+                    head++;
+                    completed++;
+                }
+                __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            }
+
+            return true;
+        }
+
+        // After a failed submit, takes back the operations the kernel hasn't read and waits for the 'inFlight'
+        // ones it has, which still point into the caller's buffers. Results are handed to 'complete' as usual
+        void Drain(size_t inFlight, const std::function<void(size_t, int)>& complete)
+        {
+            // Without SQPOLL the kernel only reads submissions during io_uring_enter
+            __atomic_store_n(sqTail, __atomic_load_n(sqHead, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+
+            while(inFlight > 0)
+            {
+                if(syscall(__NR_io_uring_enter, fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0
+                   && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                {
+                    // Nothing can tell when the kernel is done with the buffers, so it must not be allowed to outlive them
+                    std::cout << "ERROR: FileService: io_uring can't wait for pending operations\n";
+                    std::abort();
+                }
+
+                unsigned head = *cqHead;
+                unsigned cqTailValue = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+                for(; head != cqTailValue && inFlight > 0; head++, inFlight--)
+                {
+                    io_uring_cqe* cqe = &cqes[head & *cqMask];
+                    complete(static_cast<size_t>(cqe->user_data), cqe->res);
+                }
+                __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            }
+        }
+    };
+
+    FileService::FileService()
+    {
+        if(std::getenv("LEO_NO_IO_URING") != nullptr)
+            return;
+
+        mRing = std::make_unique<Ring>();
+        if(!mRing->Setup())
+            mRing.reset();
+    }
+
+    void FileService::Stat(const std::vector<std::string>& paths, std::vector<Utils::FileStamp>& stampsOut)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        StatWithRing(paths, stampsOut);
+    }
+
+    void FileService::StatWithRing(const std::vector<std::string>& paths, std::vector<Utils::FileStamp>& stampsOut)
+    {
+        if(!mRing)
+        {
+            Utils::GetFileStamps(paths, stampsOut);
+            return;
+        }
+
+        stampsOut.assign(paths.size(), Utils::FileStamp());
+        Utils::GetCounters().statCalls += paths.size();
+
+        // statx results are large, only keep buffers for one ring worth of requests
+        const size_t window = Ring::Entries * 4;
+        std::vector<struct statx> results(std::min(window, paths.size()));
+        bool success = true;
+        for(size_t begin = 0; begin < paths.size() && success; begin += window)
+        {
+            size_t count = std::min(window, paths.size() - begin);
+            success = mRing->Run(count,
+                [&](io_uring_sqe* sqe, size_t i) {
+                    sqe->opcode = IORING_OP_STATX;
+                    sqe->fd = AT_FDCWD;
+                    sqe->addr = reinterpret_cast<uint64_t>(paths[begin + i].c_str());
+                    sqe->len = STATX_MTIME | STATX_SIZE;
+                    sqe->off = reinterpret_cast<uint64_t>(&results[i]);
+                },
+                [&](size_t i, int result) {
+                    if(result < 0)
+                        return;
+
+                    Utils::FileStamp& stamp = stampsOut[begin + i];
+                    stamp.exists = true;
+                    stamp.size = results[i].stx_size;
+                    stamp.modifiedTime = static_cast<int64_t>(results[i].stx_mtime.tv_sec) * 1000000000 + results[i].stx_mtime.tv_nsec;
+                });
+        }
+
+        // A ring that failed once isn't used again
+        if(!success)
+        {
+            mRing.reset();
+            Utils::GetFileStamps(paths, stampsOut);
+        }
+    }
+
+    void FileService::Read(const std::vector<std::string>& paths, std::vector<std::string>& contentsOut, std::vector<bool>& foundOut)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(!mRing)
+        {
+            ReadWithThreads(paths, contentsOut, foundOut);
+            return;
+        }
+
+        contentsOut.assign(paths.size(), std::string());
+        foundOut.assign(paths.size(), false);
+
+        std::vector<Utils::FileStamp> stamps;
+        StatWithRing(paths, stamps);
+        if(!mRing)
+        {
+            ReadWithThreads(paths, contentsOut, foundOut);
+            return;
+        }
+
+        // Open, read and close in windows so we never hold too many descriptors at once.
+        // Reads that didn't return exactly the stat'ed size are done again to the end of the file
+        const size_t window = 128;
+        std::vector<int> fds(window, -1);
+        std::vector<size_t> rereads;
+        for(size_t begin = 0; begin < paths.size(); begin += window)
+        {
+            size_t count = std::min(window, paths.size() - begin);
+            std::fill(fds.begin(), fds.end(), -1);
+
+            bool success = mRing->Run(count,
+                [&](io_uring_sqe* sqe, size_t i) {
+                    sqe->opcode = IORING_OP_OPENAT;
+                    sqe->fd = AT_FDCWD;
+                    sqe->addr = reinterpret_cast<uint64_t>(paths[begin + i].c_str());
+                    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+                },
+                [&](size_t i, int result) {
+                    fds[i] = result;
+                });
+
+            success = success && mRing->Run(count,
+                [&](io_uring_sqe* sqe, size_t i) {
+                    // Failed opens still have to complete, a no-op does that
+                    if(fds[i] < 0)
+                    {
+                        sqe->opcode = IORING_OP_NOP;
+                        return;
+                    }
+
+                    // One byte more than the stat'ed size tells a file that grew since
+                    contentsOut[begin + i].resize(stamps[begin + i].size + 1);
+                    sqe->opcode = IORING_OP_READ;
+                    sqe->fd = fds[i];
+                    sqe->addr = reinterpret_cast<uint64_t>(contentsOut[begin + i].data());
+                    sqe->len = static_cast<uint32_t>(contentsOut[begin + i].size());
+                    sqe->off = 0;
+                },
+                [&](size_t i, int result) {
+                    // A file that only appeared after the stat is left out like one that is gone
+                    if(fds[i] < 0 || result < 0 || !stamps[begin + i].exists)
+                    {
+                        contentsOut[begin + i].clear();
+                        return;
+                    }
+
+                    // Short reads (NFS, signals) and files that changed size since the stat
+                    if(static_cast<uint64_t>(result) != stamps[begin + i].size)
+                    {
+                        rereads.push_back(begin + i);
+                        return;
+                    }
+
+                    contentsOut[begin + i].resize(static_cast<size_t>(result));
+                    foundOut[begin + i] = true;
+                });
+
+            if(!success)
+            {
+                for(int fd : fds)
+                {
+                    if(fd >= 0)
+                        close(fd);
+                }
+
+                mRing.reset();
+                ReadWithThreads(paths, contentsOut, foundOut);
+                return;
+            }
+
+            mRing->Run(count,
+                [&](io_uring_sqe* sqe, size_t i) {
+                    if(fds[i] < 0)
+                    {
+                        sqe->opcode = IORING_OP_NOP;
+                        return;
+                    }
+                    sqe->opcode = IORING_OP_CLOSE;
+                    sqe->fd = fds[i];
+                },
+                [&](size_t, int) {});
+        }
+
+        if(rereads.empty())
+            return;
+
+        std::vector<std::string> rereadPaths;
+        for(size_t index : rereads)
+            rereadPaths.push_back(paths[index]);
+
+        std::vector<std::string> rereadContents;
+        std::vector<bool> rereadFound;
+        ReadWithThreads(rereadPaths, rereadContents, rereadFound);
+        for(size_t i = 0; i < rereads.size(); i++)
+        {
+            contentsOut[rereads[i]] = std::move(rereadContents[i]);
+            foundOut[rereads[i]] = rereadFound[i];
+        }
+    }
+
+#else
+
+    struct FileService::Ring
+    {
+    };
+
+    FileService::FileService()
+    {
+    }
+
+    void FileService::Stat(const std::vector<std::string>& paths, std::vector<Utils::FileStamp>& stampsOut)
+    {
+        Utils::GetFileStamps(paths, stampsOut);
+    }
+
+    void FileService::Read(const std::vector<std::string>& paths, std::vector<std::string>& contentsOut, std::vector<bool>& foundOut)
+    {
+        ReadWithThreads(paths, contentsOut, foundOut);
+    }
+
+#endif
+
+    FileService::~FileService() = default;
+
+    bool FileService::IsUsingIoUring() const
+    {
+        return mRing != nullptr;
+    }
+
+    FileService& GetFileService()
+    {
+        static FileService fileService;
+        return fileService;
+    }
+
+    void FileService::ReadWithThreads(const std::vector<std::string>& paths, std::vector<std::string>& contentsOut, std::vector<bool>& foundOut)
+    {
+        contentsOut.assign(paths.size(), std::string());
+
+        // vector<bool> packs bits, so threads write to a byte sized copy
+        std::vector<char> found(paths.size(), 0);
+        ParallelFor(paths.size(), 64, [&](size_t begin, size_t end) {
+            for(size_t i = begin; i < end; i++)
+            {
+                std::ifstream file(paths[i], std::ios::binary);
+                if(!file.is_open())
+                    continue;
+
+                contentsOut[i].assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                found[i] = 1;
+            }
+        });
+
+        foundOut.assign(found.begin(), found.end());
+    }
+}
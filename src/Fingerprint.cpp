@@ -0,0 +1,274 @@
+#include "Fingerprint.hpp"
+
+#include <array>
+#include <cstring>
+
+namespace
+{
+    enum class CharClass : uint8_t
+    {
+        None,
+        Word,
+        Punctuator,
+        Space,
+        // Newlines, backslashes, slashes and quotes, handled one by one
+        Special
+    };
+
+    constexpr std::array<CharClass, 256> MakeCharClassTable()
+    {
+        std::array<CharClass, 256> table{};
+        for(int c = 0; c < 256; c++)
+        {
+            if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '$' || c >= 0x80)
+                table[c] = CharClass::Word;
+            else if(c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v')
+                table[c] = CharClass::Space;
+            else if(c == '\n' || c == '\\' || c == '/' || c == '"' || c == '\'')
+                table[c] = CharClass::Special;
+            else
+                table[c] = CharClass::Punctuator;
+        }
+        return table;
+    }
+
+    // Where the tokenizer is within a #define, the whitespace after the macro name tells a function-like
+    // macro "X(a)" from an object-like one "X (a)"
+    enum class DefineState : uint8_t
+    {
+        None,
+        DirectiveName,
+        MacroName,
+        AfterMacroName
+    };
+
+    constexpr std::array<CharClass, 256> charClasses = MakeCharClassTable();
+
+    inline CharClass GetCharClass(char c)
+    {
+        return charClasses[static_cast<unsigned char>(c)];
+    }
+
+    inline bool IsRawStringPrefix(const char* word, size_t length)
+    {
+        return (length == 1 && word[0] == 'R')
+            || (length == 2 && word[1] == 'R' && (word[0] == 'L' || word[0] == 'u' || word[0] == 'U'))
+            || (length == 3 && std::memcmp(word, "u8R", 3) == 0);
+    }
+}
+
+namespace Leo
+{
+    uint64_t GetTokenFingerprint(const std::string& text, bool keepLines, uint64_t seed)
+    {
+        uint64_t hash = seed;
+        auto emit = [&hash](unsigned char c) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        };
+
+        const char* s = text.data();
+        const size_t n = text.size();
+        size_t i = 0;
+
+        CharClass last = CharClass::None;
+        bool pendingSpace = false;
+        bool lineStart = true;
+        bool directive = false;
+        bool number = false;
+        size_t wordStart = 0;
+        DefineState defineState = DefineState::None;
+
+        // Line structure is kept by hashing every newline, otherwise only directives need their end marked.
+        // Newlines are hashed when the next token comes, so blank lines at the end don't count
+        size_t pendingNewlines = 0;
+        auto newline = [&]() {
+            if(keepLines || directive)
+            {
+                pendingNewlines = keepLines ? pendingNewlines + 1 : 1;
+                last = CharClass::None;
+            }
+            else
+            {
+                pendingSpace = true;
+            }
+        };
+
+        // Called before the first character of every token, returns true if whitespace preceded it
+        auto beginToken = [&](CharClass current) {
+            for(; pendingNewlines > 0; pendingNewlines--)
+                emit('\n');
+
+            // Whitespace matters only where the tokens on both sides would merge, or after a macro name
+            bool spaced = pendingSpace;
+            if(spaced && (current == last || defineState == DefineState::AfterMacroName))
+                emit(' ');
+            if(defineState == DefineState::AfterMacroName)
+                defineState = DefineState::None;
+            pendingSpace = false;
+            lineStart = false;
+            return spaced;
+        };
+
+        while(i < n)
+        {
+            char c = s[i];
+            CharClass current = GetCharClass(c);
+
+            // Most of the text, handled without looking at each character twice
+            if(current == CharClass::Word)
+            {
+                if(last != CharClass::Word || pendingSpace || pendingNewlines > 0)
+                {
+                    wordStart = i;
+                    number = (c >= '0' && c <= '9');
+                }
+                beginToken(current);
+
+                do
+                {
+                    emit(s[i++]);
+                } while(i < n && GetCharClass(s[i]) == CharClass::Word);
+
+                if(defineState == DefineState::DirectiveName)
+                    defineState = (i - wordStart == 6 && std::memcmp(s + wordStart, "define", 6) == 0) ? DefineState::MacroName : DefineState::None;
+                else if(defineState == DefineState::MacroName)
+                    defineState = DefineState::AfterMacroName;
+
+                last = CharClass::Word;
+                continue;
+            }
+
+            if(current == CharClass::Space)
+            {
+                pendingSpace = true;
+                i++;
+                continue;
+            }
+
+            if(current == CharClass::Punctuator)
+            {
+                bool hash = (lineStart && c == '#');
+                if(hash)
+                    directive = true;
+                beginToken(current);
+                emit(c);
+                defineState = hash ? DefineState::DirectiveName : DefineState::None;
+                last = current;
+                i++;
+                continue;
+            }
+
+            // Backslash-newline splices two lines into one
+            if(c == '\\' && i + 1 < n && (s[i + 1] == '\n' || (s[i + 1] == '\r' && i + 2 < n && s[i + 2] == '\n')))
+            {
+                i += (s[i + 1] == '\n') ? 2 : 3;
+                if(keepLines)
+                    emit('\\');
+                continue;
+            }
+
+            if(c == '\n')
+            {
+                newline();
+                directive = false;
+                defineState = DefineState::None;
+                lineStart = true;
+                i++;
+                continue;
+            }
+
+            if(c == '/' && i + 1 < n && s[i + 1] == '/')
+            {
+                // Ends at the newline, which is handled above, unless it's spliced
+                while(i < n && s[i] != '\n')
+                {
+                    if(s[i] == '\\' && i + 1 < n && s[i + 1] == '\n')
+                    {
+                        if(keepLines)
+                            emit('\\');
+                        i++;
+                    }
+                    i++;
+                }
+                pendingSpace = true;
+                continue;
+            }
+
+            if(c == '/' && i + 1 < n && s[i + 1] == '*')
+            {
+                i += 2;
+                while(i < n && !(s[i] == '*' && i + 1 < n && s[i + 1] == '/'))
+                {
+                    // Keeps __LINE__ of the code after a multi-line comment
+                    if(s[i] == '\n' && keepLines)
+                        pendingNewlines++;
+                    i++;
+                }
+                i += 2;
+                pendingSpace = true;
+                continue;
+            }
+
+            // Digit separators belong to the number, they don't start a character literal
+            if(c == '\'' && number && last == CharClass::Word && !pendingSpace && pendingNewlines == 0)
+            {
+                emit(c);
+                i++;
+                continue;
+            }
+
+            if(c != '"' && c != '\'')
+            {
+                // A lone slash or backslash
+                beginToken(CharClass::Punctuator);
+                emit(c);
+                defineState = DefineState::None;
+                last = CharClass::Punctuator;
+                i++;
+                continue;
+            }
+
+            // Only a word in front can merge with a literal, as its encoding prefix
+            bool spaced = beginToken(CharClass::Word);
+            defineState = DefineState::None;
+            bool raw = (c == '"' && !spaced && last == CharClass::Word && IsRawStringPrefix(s + wordStart, i - wordStart));
+            emit(c);
+            i++;
+
+            if(raw)
+            {
+                // R"delimiter( ... )delimiter" may contain anything, newlines included
+                size_t open = i;
+                while(i < n && s[i] != '(' && i - open < 16)
+                    i++;
+
+                std::string terminator = ")" + text.substr(open, i - open) + "\"";
+                size_t end = text.find(terminator, i);
+                end = (end == std::string::npos) ? n : end + terminator.size();
+                for(size_t j = open; j < end; j++)
+                    emit(s[j]);
+                i = end;
+            }
+            else
+            {
+                while(i < n && s[i] != c && s[i] != '\n')
+                {
+                    if(s[i] == '\\' && i + 1 < n)
+                        emit(s[i++]);
+                    emit(s[i++]);
+                }
+
+                if(i < n && s[i] == c)
+                    emit(s[i++]);
+            }
+
+            // A word right after a literal is its suffix, keep it apart from a separate word
+            last = CharClass::Word;
+            number = false;
+            wordStart = i;
+        }
+
+        return hash;
+    }
+}
@@ -0,0 +1,257 @@
+#include "History.hpp"
+#include "Utils.hpp"
+
+#include <map>
+#include <cmath>
+#include <ctime>
+#include <iomanip>
+#include <algorithm>
+#include <unordered_map>
+
+static const uint32_t historyMagic = 0x484f454c; // "LEOH"
+static const uint32_t historyVersion = 1;
+
+// Far beyond any real project, a corrupt count must not turn into a huge allocation
+static const uint32_t maxHistoryEntries = 1 << 20;
+
+namespace Leo
+{
+    bool BuildHistory::Load(std::string filepath)
+    {
+        mRecords.clear();
+
+        std::ifstream file(filepath, std::ios::binary);
+        if(!file.is_open())
+            return false;
+
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        Utils::ReadBinary(file, magic);
+        Utils::ReadBinary(file, version);
+        if(magic != historyMagic || version != historyVersion)
+        {
+            std::cout << "WARNING: BuildHistory: Ignoring incompatible history file: " << filepath << "\n";
+            return false;
+        }
+
+        // Source paths are stored once and referenced by index from each build
+        uint32_t pathCount = 0;
+        std::vector<std::string> paths;
+        if(Utils::ReadBinary(file, pathCount) && pathCount <= maxHistoryEntries)
+        {
+            paths.resize(pathCount);
+            for(size_t i = 0; i < paths.size() && file; i++)
+                Utils::ReadBinary(file, paths[i]);
+        }
+
+        if(!file || pathCount > maxHistoryEntries)
+        {
+            std::cout << "WARNING: BuildHistory: Ignoring corrupt history file: " << filepath << "\n";
+            return false;
+        }
+
+        uint32_t buildCount = 0;
+        Utils::ReadBinary(file, buildCount);
+        for(uint32_t i = 0; i < buildCount && file; i++)
+        {
+            BuildRecord build;
+            uint32_t sourceCount = 0;
+            Utils::ReadBinary(file, build.timestamp);
+            Utils::ReadBinary(file, build.wallSeconds);
+            Utils::ReadBinary(file, build.gitHead);
+            if(!Utils::ReadBinary(file, sourceCount) || sourceCount > maxHistoryEntries)
+                break;
+
+            build.sources.resize(sourceCount);
+            for(SourceRecord& source : build.sources)
+            {
+                if(!file)
+                    break;
+
+                uint32_t pathIndex = 0;
+                uint8_t cacheHit = 0;
+                Utils::ReadBinary(file, pathIndex);
+                Utils::ReadBinary(file, source.wallSeconds);
+                Utils::ReadBinary(file, source.cpuSeconds);
+                Utils::ReadBinary(file, source.peakMemoryKB);
+                Utils::ReadBinary(file, source.dependencyCount);
+                Utils::ReadBinary(file, cacheHit);
+                Utils::ReadBinary(file, source.flagHash);
+
+                if(pathIndex < paths.size())
+                    source.source = paths[pathIndex];
+                source.cacheHit = (cacheHit != 0);
+            }
+
+            if(file)
+                mRecords.push_back(std::move(build));
+        }
+
+        return true;
+    }
+
+    bool BuildHistory::Save(std::string filepath)
+    {
+        std::vector<std::string> paths;
+        std::unordered_map<std::string, uint32_t> pathIndices;
+        for(const BuildRecord& build : mRecords)
+        {
+            for(const SourceRecord& source : build.sources)
+            {
+                if(pathIndices.emplace(source.source, static_cast<uint32_t>(paths.size())).second)
+                    paths.push_back(source.source);
+            }
+        }
+
+        // Write next to the real file first so an interrupted build can't leave it truncated
+        std::string tmpPath = filepath + ".tmp";
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!file.is_open())
+        {
+            std::cout << "ERROR: BuildHistory: Failed to write history file: " << filepath << "\n";
+            return false;
+        }
+
+        Utils::WriteBinary(file, historyMagic);
+        Utils::WriteBinary(file, historyVersion);
+
+        Utils::WriteBinary(file, static_cast<uint32_t>(paths.size()));
+        for(const std::string& path : paths)
+            Utils::WriteBinary(file, path);
+
+        Utils::WriteBinary(file, static_cast<uint32_t>(mRecords.size()));
+        for(const BuildRecord& build : mRecords)
+        {
+            Utils::WriteBinary(file, build.timestamp);
+            Utils::WriteBinary(file, build.wallSeconds);
+            Utils::WriteBinary(file, build.gitHead);
+            Utils::WriteBinary(file, static_cast<uint32_t>(build.sources.size()));
+
+            for(const SourceRecord& source : build.sources)
+            {
+                Utils::WriteBinary(file, pathIndices[source.source]);
+                Utils::WriteBinary(file, source.wallSeconds);
+                Utils::WriteBinary(file, source.cpuSeconds);
+                Utils::WriteBinary(file, source.peakMemoryKB);
+                Utils::WriteBinary(file, source.dependencyCount);
+                Utils::WriteBinary(file, static_cast<uint8_t>(source.cacheHit ? 1 : 0));
+                Utils::WriteBinary(file, source.flagHash);
+            }
+        }
+
+        file.close();
+        std::error_code error;
+        std::filesystem::rename(tmpPath, filepath, error);
+        return !error;
+    }
+
+    void BuildHistory::Append(BuildRecord record)
+    {
+        mRecords.push_back(std::move(record));
+
+        // Behave as a ring buffer, the oldest builds make room for new ones
+        if(mRecords.size() > Capacity)
+            mRecords.erase(mRecords.begin(), mRecords.end() - Capacity);
+    }
+
+    const std::vector<BuildHistory::BuildRecord>& BuildHistory::GetRecords() const
+    {
+        return mRecords;
+    }
+
+    void BuildHistory::DisplayReport(int buildCount)
+    {
+        if(mRecords.empty())
+        {
+            std::cout << "No build history recorded yet\n";
+            return;
+        }
+
+        if(buildCount <= 0 || buildCount > static_cast<int>(mRecords.size()))
+            buildCount = static_cast<int>(mRecords.size());
+
+        std::vector<BuildRecord>::const_iterator first = mRecords.end() - buildCount;
+
+        std::cout << "Last " << buildCount << " build(s):\n";
+        for(std::vector<BuildRecord>::const_iterator build = first; build != mRecords.end(); build++)
+        {
+            int compiled = 0;
+            for(const SourceRecord& source : build->sources)
+                if(!source.cacheHit) compiled++;
+
+            std::time_t timestamp = static_cast<std::time_t>(build->timestamp);
+            std::cout << "    " << std::put_time(std::localtime(&timestamp), "%Y-%m-%d %H:%M:%S")
+                      << "  " << std::fixed << std::setprecision(2) << build->wallSeconds << "s"
+                      << "  compiled " << compiled << "/" << build->sources.size();
+            if(!build->gitHead.empty())
+                std::cout << "  " << build->gitHead.substr(0, 12);
+            std::cout << "\n";
+        }
+
+        // Collect compile times of every source in chronological order, cache hits carry no timing
+        std::map<std::string, std::vector<float>> samples;
+        for(std::vector<BuildRecord>::const_iterator build = first; build != mRecords.end(); build++)
+        {
+            for(const SourceRecord& source : build->sources)
+                if(!source.cacheHit) samples[source.source].push_back(source.wallSeconds);
+        }
+
+        struct Change
+        {
+            std::string source;
+            double baseline;
+            double latest;
+            bool significant;
+        };
+        std::vector<Change> changes;
+
+        for(const auto& [source, times] : samples)
+        {
+            // Need at least one earlier sample to compare the latest one against
+            if(times.size() < 2)
+                continue;
+
+            double mean = 0.0;
+            for(size_t i = 0; i + 1 < times.size(); i++)
+                mean += times[i];
+            mean /= (times.size() - 1);
+
+            double variance = 0.0;
+            for(size_t i = 0; i + 1 < times.size(); i++)
+                variance += (times[i] - mean) * (times[i] - mean);
+            if(times.size() > 2)
+                variance /= (times.size() - 2);
+
+            double latest = times.back();
+            if(latest <= mean)
+                continue;
+
+            // Treat the latest time as a regression once it is more than three standard
+            // deviations above the earlier mean. Timer and scheduler noise puts a floor on
+            // the deviation so tiny sources don't trigger on jitter alone
+            double deviation = std::max(std::sqrt(variance), std::max(mean * 0.05, 0.01));
+            bool significant = times.size() >= 4 && (latest - mean) > 3.0 * deviation;
+            changes.push_back({ source, mean, latest, significant });
+        }
+
+        if(changes.empty())
+        {
+            std::cout << "No sources got slower\n";
+            return;
+        }
+
+        std::sort(changes.begin(), changes.end(), [](const Change& a, const Change& b) {
+            return (a.latest - a.baseline) > (b.latest - b.baseline);
+        });
+
+        std::cout << "Sources that got slower:\n";
+        for(const Change& change : changes)
+        {
+            std::cout << "    " << (change.significant ? "REGRESSION " : "           ")
+                      << std::fixed << std::setprecision(3)
+                      << change.baseline << "s -> " << change.latest << "s"
+                      << " (+" << std::setprecision(1) << (change.latest - change.baseline) / std::max(change.baseline, 0.001) * 100.0 << "%)  "
+                      << change.source << "\n";
+        }
+    }
+}
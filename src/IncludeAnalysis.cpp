@@ -0,0 +1,176 @@
+#include "IncludeAnalysis.hpp"
+#include "StatCache.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace Leo
+{
+    bool IncludeAnalysis::AddCompileOutput(const std::string& source, const std::string& output)
+    {
+        double parseSeconds = GetParseSeconds(output);
+        if(parseSeconds <= 0.0)
+            return false;
+
+        // -H prints every header read as "<one dot per level> <path>", in the order it is read
+        struct Entry
+        {
+            std::string path;
+            size_t depth = 0;
+            uint64_t bytes = 0;
+        };
+
+        std::vector<Entry> entries;
+        std::vector<size_t> open;
+        uint64_t totalBytes = GetFileSize(source);
+
+        std::istringstream lines(output);
+        std::string line;
+        while(std::getline(lines, line))
+        {
+            if(!line.empty() && line.back() == '\r')
+                line.pop_back();
+
+            // Followed by a list of headers without include guards, not part of the tree
+            if(line.rfind("Multiple include guards may be useful for:", 0) == 0)
+                break;
+
+            size_t depth = line.find_first_not_of('.');
+            if(depth == 0 || depth == std::string::npos || line[depth] != ' ')
+                continue;
+
+            Entry entry;
+            entry.path = std::filesystem::path(line.substr(depth + 1)).lexically_normal().generic_string();
+            entry.depth = depth;
+
+            // Every header still open above this one includes it
+            while(!open.empty() && entries[open.back()].depth >= depth)
+                open.pop_back();
+
+            uint64_t bytes = GetFileSize(entry.path);
+            totalBytes += bytes;
+            entry.bytes = bytes;
+            for(size_t index : open)
+                entries[index].bytes += bytes;
+
+            open.push_back(entries.size());
+            entries.push_back(std::move(entry));
+        }
+
+        // Headers read several times (no include guard) are charged for each time
+        std::unordered_map<std::string, uint64_t> headerBytes;
+        for(const Entry& entry : entries)
+            headerBytes[entry.path] += entry.bytes;
+
+        for(const auto& [header, bytes] : headerBytes)
+        {
+            Cost& cost = mHeaders[header];
+            cost.bytes += bytes;
+            cost.seconds += (totalBytes > 0) ? parseSeconds * static_cast<double>(bytes) / static_cast<double>(totalBytes) : 0.0;
+            cost.sources++;
+        }
+
+        mSourceCount++;
+        mParseSeconds += parseSeconds;
+        return true;
+    }
+
+    size_t IncludeAnalysis::GetSourceCount() const
+    {
+        return mSourceCount;
+    }
+
+    void IncludeAnalysis::Display(size_t count) const
+    {
+        std::cout << "Analyzed " << mSourceCount << " source(s), " << std::fixed << std::setprecision(2)
+                  << mParseSeconds << "s of parsing in total\n";
+        std::cout << "Headers by build seconds saved if removed:\n";
+
+        std::vector<std::pair<std::string, Cost>> sorted = GetSorted();
+        for(size_t i = 0; i < sorted.size() && i < count; i++)
+        {
+            const Cost& cost = sorted[i].second;
+            std::cout << "    " << std::fixed << std::setprecision(3) << std::setw(9) << cost.seconds << "s"
+                      << "  " << std::setw(8) << (cost.bytes / cost.sources + 512) / 1024 << " KB each"
+                      << "  in " << std::setw(5) << cost.sources << " source(s)  " << sorted[i].first << "\n";
+        }
+    }
+
+    bool IncludeAnalysis::Save(std::string filepath) const
+    {
+        std::ofstream file(filepath, std::ios::trunc);
+        if(!file.is_open())
+            return false;
+
+        std::vector<std::pair<std::string, Cost>> sorted = GetSorted();
+        file << "{\n  \"sources\": " << mSourceCount << ",\n  \"parse_seconds\": " << std::fixed << std::setprecision(6)
+             << mParseSeconds << ",\n  \"headers\": [";
+        for(size_t i = 0; i < sorted.size(); i++)
+        {
+            file << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << Utils::EscapeJson(sorted[i].first) << "\", \"seconds_saved\": "
+                 << sorted[i].second.seconds << ", \"bytes\": " << sorted[i].second.bytes << ", \"sources\": " << sorted[i].second.sources << "}";
+        }
+        file << "\n  ]\n}\n";
+        return static_cast<bool>(file);
+    }
+
+    uint64_t IncludeAnalysis::GetFileSize(const std::string& path)
+    {
+        auto known = mFileSizes.find(path);
+        if(known != mFileSizes.end())
+            return known->second;
+
+        uint64_t size = GetStatCache().Get(path).size;
+        mFileSizes[path] = size;
+        return size;
+    }
+
+    std::vector<std::pair<std::string, IncludeAnalysis::Cost>> IncludeAnalysis::GetSorted() const
+    {
+        std::vector<std::pair<std::string, Cost>> sorted(mHeaders.begin(), mHeaders.end());
+        std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, Cost>& a, const std::pair<std::string, Cost>& b) {
+            return a.second.seconds > b.second.seconds;
+        });
+        return sorted;
+    }
+
+    double IncludeAnalysis::GetParseSeconds(const std::string& output)
+    {
+        // " phase parsing : 0.49 ( 91%) 0.32 ( 94%) 0.85 ( 91%) 46M ( 88%)" since GCC 10, with "usr", "sys" and
+        // "wall" after each number before. Wall time grows with the number of parallel jobs, user and system
+        // time don't. Deferred template instantiation is part of parsing the source
+        double seconds = 0.0;
+        std::istringstream lines(output);
+        std::string line;
+        while(std::getline(lines, line))
+        {
+            if(line.rfind(" phase parsing", 0) != 0 && line.rfind(" phase lang. deferred", 0) != 0)
+                continue;
+
+            size_t colon = line.find(':');
+            if(colon == std::string::npos)
+                continue;
+
+            std::vector<std::string> tokens;
+            std::istringstream words(line.substr(colon + 1));
+            std::string word;
+            while(words >> word)
+            {
+                if(word.front() != '(' && word.back() != ')')
+                    tokens.push_back(word);
+            }
+
+            auto user = std::find(tokens.begin(), tokens.end(), "usr");
+            auto system = std::find(tokens.begin(), tokens.end(), "sys");
+            if(user != tokens.end() && system != tokens.end() && user != tokens.begin() && system != tokens.begin())
+                seconds += std::strtod((user - 1)->c_str(), nullptr) + std::strtod((system - 1)->c_str(), nullptr);
+            else if(tokens.size() >= 2)
+                seconds += std::strtod(tokens[0].c_str(), nullptr) + std::strtod(tokens[1].c_str(), nullptr);
+        }
+        return seconds;
+    }
+}
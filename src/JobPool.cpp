@@ -0,0 +1,114 @@
+#include "JobPool.hpp"
+
+#include <algorithm>
+
+namespace Leo
+{
+    JobPool::JobPool(size_t workerCount)
+    {
+        if(workerCount == 0)
+            workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+        for(size_t i = 0; i < workerCount; i++)
+            mWorkers.emplace_back(&JobPool::RunWorker, this);
+    }
+
+    JobPool::~JobPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mJobAvailable.notify_all();
+
+        // Queued jobs still run, nothing submitted gets lost
+        for(std::thread& worker : mWorkers)
+            worker.join();
+    }
+
+    void JobPool::Submit(std::function<void()> job, std::string resource)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mJobs.push_back({ std::move(job), std::move(resource) });
+        }
+        mJobAvailable.notify_one();
+    }
+
+    void JobPool::SetResourceLimit(const std::string& resource, size_t limit)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            limit = std::max<size_t>(limit, 1);
+            auto [it, inserted] = mResourceLimits.emplace(resource, limit);
+            if(!inserted)
+                it->second = std::min(it->second, limit);
+        }
+        mJobAvailable.notify_all();
+    }
+
+    void JobPool::Wait()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mJobsFinished.wait(lock, [this]() { return mJobs.empty() && mRunningJobs == 0; });
+    }
+
+    void JobPool::Cancel()
+    {
+        mCancelled = true;
+    }
+
+    bool JobPool::IsCancelled() const
+    {
+        return mCancelled;
+    }
+
+    size_t JobPool::GetWorkerCount() const
+    {
+        return mWorkers.size();
+    }
+
+    void JobPool::RunWorker()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while(true)
+        {
+            // Jobs left waiting for their resource are started by the worker releasing it
+            auto next = mJobs.end();
+            mJobAvailable.wait(lock, [this, &next]() {
+                next = FindRunnableJob();
+                return next != mJobs.end() || (mStopping && mJobs.empty());
+            });
+            if(next == mJobs.end())
+                return;
+
+            std::function<void()> job = std::move(next->job);
+            std::string resource = std::move(next->resource);
+            mJobs.erase(next);
+            mRunningJobs++;
+            mResourceUsage[resource]++;
+
+            lock.unlock();
+            job();
+            lock.lock();
+
+            mRunningJobs--;
+            mResourceUsage[resource]--;
+            if(mJobs.empty() && mRunningJobs == 0)
+                mJobsFinished.notify_all();
+            else if(!mJobs.empty() && mResourceLimits.count(resource) != 0)
+                mJobAvailable.notify_all();
+        }
+    }
+
+    std::deque<JobPool::QueuedJob>::iterator JobPool::FindRunnableJob()
+    {
+        for(auto it = mJobs.begin(); it != mJobs.end(); ++it)
+        {
+            auto limit = mResourceLimits.find(it->resource);
+            if(limit == mResourceLimits.end() || mResourceUsage[it->resource] < limit->second)
+                return it;
+        }
+        return mJobs.end();
+    }
+}
@@ -0,0 +1,131 @@
+#include "Manifest.hpp"
+#include "FileService.hpp"
+#include "StatCache.hpp"
+
+#include <algorithm>
+
+static const uint32_t manifestMagic = 0x4d4f454c; // "LEOM"
+static const uint32_t manifestVersion = 1;
+
+// Every input and output of a build, far beyond any real project
+static const uint32_t maxManifestPaths = 1 << 22;
+
+namespace Leo
+{
+    bool BuildManifest::Load(std::string filepath)
+    {
+        mPaths.clear();
+        mStamps.clear();
+
+        std::ifstream file(filepath, std::ios::binary);
+        if(!file.is_open())
+            return false;
+
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        uint32_t count = 0;
+        Utils::ReadBinary(file, magic);
+        Utils::ReadBinary(file, version);
+        if(magic != manifestMagic || version != manifestVersion)
+            return false;
+
+        // A corrupt count must not turn into a huge allocation, the entries are read as they come
+        if(!Utils::ReadBinary(file, mOptionsHash) || !Utils::ReadBinary(file, count) || count > maxManifestPaths)
+            return false;
+
+        for(uint32_t i = 0; i < count && file; i++)
+        {
+            std::string path;
+            Utils::FileStamp stamp;
+            stamp.exists = true;
+            if(Utils::ReadBinary(file, path) && Utils::ReadBinary(file, stamp.modifiedTime) && Utils::ReadBinary(file, stamp.size))
+            {
+                mPaths.push_back(std::move(path));
+                mStamps.push_back(stamp);
+            }
+        }
+
+        if(!file)
+        {
+            mPaths.clear();
+            mStamps.clear();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool BuildManifest::Save(std::string filepath)
+    {
+        std::string tmpPath = filepath + ".tmp";
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!file.is_open())
+            return false;
+
+        Utils::WriteBinary(file, manifestMagic);
+        Utils::WriteBinary(file, manifestVersion);
+        Utils::WriteBinary(file, mOptionsHash);
+        Utils::WriteBinary(file, static_cast<uint32_t>(mPaths.size()));
+        for(size_t i = 0; i < mPaths.size(); i++)
+        {
+            Utils::WriteBinary(file, mPaths[i]);
+            Utils::WriteBinary(file, mStamps[i].modifiedTime);
+            Utils::WriteBinary(file, mStamps[i].size);
+        }
+        file.close();
+
+        std::error_code error;
+        std::filesystem::rename(tmpPath, filepath, error);
+        return !error;
+    }
+
+    void BuildManifest::SetOptionsHash(uint64_t optionsHash)
+    {
+        mOptionsHash = optionsHash;
+    }
+
+    void BuildManifest::AddFile(std::string path)
+    {
+        mPaths.push_back(std::move(path));
+    }
+
+    bool BuildManifest::Finalize()
+    {
+        // Headers are shared by many sources, keep each path once
+        std::sort(mPaths.begin(), mPaths.end());
+        mPaths.erase(std::unique(mPaths.begin(), mPaths.end()), mPaths.end());
+
+        // Most of these were stat'ed by the build already
+        StatCache& statCache = GetStatCache();
+        std::vector<StatCache::PathId> ids;
+        for(const std::string& path : mPaths)
+            ids.push_back(statCache.Intern(path));
+        statCache.Prefetch(ids);
+
+        mStamps.clear();
+        for(StatCache::PathId id : ids)
+        {
+            mStamps.push_back(statCache.Get(id));
+            if(!mStamps.back().exists)
+                return false;
+        }
+
+        return true;
+    }
+
+    bool BuildManifest::IsUpToDate(uint64_t optionsHash)
+    {
+        if(mPaths.empty() || optionsHash != mOptionsHash)
+            return false;
+
+        std::vector<Utils::FileStamp> stamps;
+        FileService fileService;
+        fileService.Stat(mPaths, stamps);
+        return stamps == mStamps;
+    }
+
+    size_t BuildManifest::GetFileCount() const
+    {
+        return mPaths.size();
+    }
+}
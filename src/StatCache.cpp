@@ -0,0 +1,144 @@
+#include "StatCache.hpp"
+
+namespace Leo
+{
+    StatCache::PathId StatCache::Intern(const std::string& path)
+    {
+        // "./obj/a.obj" and "obj/a.obj" are the same file
+        std::string key = (path.compare(0, 2, "./") == 0) ? path.substr(2) : path;
+
+        uint32_t shardIndex = static_cast<uint32_t>(std::hash<std::string>()(key)) & (ShardCount - 1);
+        Shard& shard = mShards[shardIndex];
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto [it, inserted] = shard.indices.emplace(key, static_cast<uint32_t>(shard.paths.size()));
+        if(inserted)
+        {
+            shard.paths.push_back(key);
+            shard.entries.emplace_back();
+        }
+
+        return (it->second << ShardBits) | shardIndex;
+    }
+
+    std::string StatCache::GetPath(PathId id)
+    {
+        Shard& shard = mShards[id & (ShardCount - 1)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.paths[id >> ShardBits];
+    }
+
+    Utils::FileStamp StatCache::Get(PathId id)
+    {
+        Shard& shard = mShards[id & (ShardCount - 1)];
+        uint32_t index = id >> ShardBits;
+
+        std::string path;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if(shard.entries[index].state == EntryState::Valid)
+            {
+                mHits++;
+                return shard.entries[index].stamp;
+            }
+            path = shard.paths[index];
+        }
+
+        // Stat outside the lock, racing threads store the same result
+        mMisses++;
+        Utils::FileStamp stamp = Utils::GetFileStamp(path);
+
+        uint64_t digest = MakeDigest(path, stamp);
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries[index].stamp = stamp;
+        shard.entries[index].digest = digest;
+        shard.entries[index].state = EntryState::Valid;
+        return stamp;
+    }
+
+    Utils::FileStamp StatCache::Get(const std::string& path)
+    {
+        return Get(Intern(path));
+    }
+
+    uint64_t StatCache::GetDigest(PathId id)
+    {
+        Get(id);
+
+        Shard& shard = mShards[id & (ShardCount - 1)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.entries[id >> ShardBits].digest;
+    }
+
+    void StatCache::Prefetch(const std::vector<PathId>& ids)
+    {
+        std::vector<PathId> missing;
+        std::vector<std::string> paths;
+        for(PathId id : ids)
+        {
+            Shard& shard = mShards[id & (ShardCount - 1)];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            Entry& entry = shard.entries[id >> ShardBits];
+            if(entry.state != EntryState::Unknown)
+                continue;
+
+            // Duplicates in 'ids' and other prefetching threads skip pending entries
+            entry.state = EntryState::Pending;
+            missing.push_back(id);
+            paths.push_back(shard.paths[id >> ShardBits]);
+        }
+
+        if(missing.empty())
+            return;
+
+        std::vector<Utils::FileStamp> stamps;
+        GetFileService().Stat(paths, stamps);
+        mMisses += missing.size();
+
+        for(size_t i = 0; i < missing.size(); i++)
+        {
+            Shard& shard = mShards[missing[i] & (ShardCount - 1)];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            Entry& entry = shard.entries[missing[i] >> ShardBits];
+            entry.stamp = stamps[i];
+            entry.digest = MakeDigest(paths[i], stamps[i]);
+            entry.state = EntryState::Valid;
+        }
+    }
+
+    void StatCache::Invalidate(const std::string& path)
+    {
+        PathId id = Intern(path);
+        Shard& shard = mShards[id & (ShardCount - 1)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries[id >> ShardBits].state = EntryState::Unknown;
+    }
+
+    uint64_t StatCache::MakeDigest(const std::string& path, const Utils::FileStamp& stamp)
+    {
+        // A missing file hashes differently from any stamp it could have had
+        uint64_t digest = Utils::HashString(path);
+        if(!stamp.exists)
+            return digest;
+
+        digest = Utils::HashValue(static_cast<uint64_t>(stamp.modifiedTime), digest);
+        return Utils::HashValue(stamp.size, digest);
+    }
+
+    uint64_t StatCache::GetHitCount() const
+    {
+        return mHits;
+    }
+
+    uint64_t StatCache::GetMissCount() const
+    {
+        return mMisses;
+    }
+
+    StatCache& GetStatCache()
+    {
+        static StatCache statCache;
+        return statCache;
+    }
+}
@@ -0,0 +1,155 @@
+#include "SystemHeaders.hpp"
+#include "StatCache.hpp"
+
+static const uint32_t systemHeadersMagic = 0x5345454c; // "LEES"
+static const uint32_t systemHeadersVersion = 1;
+
+namespace Leo
+{
+    bool SystemHeaderState::Load(std::string filepath)
+    {
+        mLastFingerprint = 0;
+        mHeaders.clear();
+
+        std::ifstream file(filepath, std::ios::binary);
+        if(!file.is_open())
+            return false;
+
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        uint32_t headerCount = 0;
+        Utils::ReadBinary(file, magic);
+        Utils::ReadBinary(file, version);
+        if(magic != systemHeadersMagic || version != systemHeadersVersion)
+            return false;
+
+        Utils::ReadBinary(file, mLastFingerprint);
+        Utils::ReadBinary(file, headerCount);
+        for(uint32_t i = 0; i < headerCount && file; i++)
+        {
+            std::string path;
+            uint64_t stampDigest = 0;
+            Utils::ReadBinary(file, path);
+            Utils::ReadBinary(file, stampDigest);
+            mHeaders[path] = stampDigest;
+        }
+
+        if(!file)
+        {
+            mLastFingerprint = 0;
+            mHeaders.clear();
+        }
+        return static_cast<bool>(file);
+    }
+
+    bool SystemHeaderState::Save(std::string filepath)
+    {
+        std::string tmpPath = filepath + ".tmp";
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!file.is_open())
+            return false;
+
+        Utils::WriteBinary(file, systemHeadersMagic);
+        Utils::WriteBinary(file, systemHeadersVersion);
+        Utils::WriteBinary(file, mLastFingerprint);
+        Utils::WriteBinary(file, static_cast<uint32_t>(mHeaders.size()));
+        for(const auto& [path, stampDigest] : mHeaders)
+        {
+            Utils::WriteBinary(file, path);
+            Utils::WriteBinary(file, stampDigest);
+        }
+        file.close();
+
+        std::error_code error;
+        std::filesystem::rename(tmpPath, filepath, error);
+        return !error;
+    }
+
+    uint64_t SystemHeaderState::GetFingerprint(const ToolchainProbe& probe)
+    {
+        StatCache& statCache = GetStatCache();
+        uint64_t fingerprint = probe.GetIdentity();
+        for(const std::string& path : GetWatchedPaths(probe))
+            fingerprint = Utils::HashValue(statCache.GetDigest(statCache.Intern(path)), fingerprint);
+        return fingerprint;
+    }
+
+    std::vector<std::string> SystemHeaderState::GetWatchedPaths(const ToolchainProbe& probe)
+    {
+        // Package managers rewrite these on every install, upgrade or removal
+        std::vector<std::string> candidates = {
+            "/var/lib/dpkg/status",
+            "/var/lib/rpm/rpmdb.sqlite",
+            "/var/lib/rpm/Packages",
+            "/var/lib/pacman/local",
+            "/lib/apk/db/installed"
+        };
+
+    #ifdef _WIN32
+        // MSYS2 keeps its database two levels above mingw64/bin
+        if(!probe.GetCompilerFile().empty())
+        {
+            std::filesystem::path root = std::filesystem::path(probe.GetCompilerFile()).parent_path().parent_path().parent_path();
+            candidates.push_back((root / "var/lib/pacman/local").generic_string());
+        }
+    #endif
+
+        if(!probe.GetCompilerFile().empty())
+            candidates.push_back(probe.GetCompilerFile());
+
+        // Directory stamps change when headers are added or removed
+        for(const std::string& directory : probe.GetSystemIncludeDirs())
+            candidates.push_back(directory);
+
+        StatCache& statCache = GetStatCache();
+        std::vector<std::string> paths;
+        for(const std::string& path : candidates)
+        {
+            if(statCache.Get(path).exists)
+                paths.push_back(path);
+        }
+        return paths;
+    }
+
+    uint64_t SystemHeaderState::GetLastFingerprint() const
+    {
+        return mLastFingerprint;
+    }
+
+    void SystemHeaderState::SetLastFingerprint(uint64_t fingerprint)
+    {
+        mLastFingerprint = fingerprint;
+    }
+
+    bool SystemHeaderState::Recheck() const
+    {
+        StatCache& statCache = GetStatCache();
+        std::vector<StatCache::PathId> ids;
+        for(const auto& [path, stampDigest] : mHeaders)
+            ids.push_back(statCache.Intern(path));
+        statCache.Prefetch(ids);
+
+        size_t index = 0;
+        for(const auto& [path, stampDigest] : mHeaders)
+        {
+            if(statCache.GetDigest(ids[index++]) != stampDigest)
+                return false;
+        }
+        return true;
+    }
+
+    void SystemHeaderState::AddHeaders(const std::vector<std::string>& headers)
+    {
+        StatCache& statCache = GetStatCache();
+        for(const std::string& header : headers)
+        {
+            if(mHeaders.find(header) == mHeaders.end())
+                mHeaders[header] = statCache.GetDigest(statCache.Intern(header));
+        }
+    }
+
+    size_t SystemHeaderState::GetHeaderCount() const
+    {
+        return mHeaders.size();
+    }
+}
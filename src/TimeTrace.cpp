@@ -0,0 +1,248 @@
+#include "TimeTrace.hpp"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+static void SkipWhitespace(const std::string& text, size_t& position)
+{
+    while(position < text.length() && std::isspace(static_cast<unsigned char>(text[position])))
+        position++;
+}
+
+static bool ReadString(const std::string& text, size_t& position, std::string& stringOut)
+{
+    if(position >= text.length() || text[position] != '"')
+        return false;
+
+    stringOut.clear();
+    for(position++; position < text.length() && text[position] != '"'; position++)
+    {
+        if(text[position] != '\\' || position + 1 >= text.length())
+        {
+            stringOut += text[position];
+            continue;
+        }
+
+        // Template names only need the common escapes, anything else becomes '?'
+        char escaped = text[++position];
+        switch(escaped)
+        {
+        case 'n': stringOut += '\n'; break;
+        case 't': stringOut += '\t'; break;
+        case 'u': stringOut += '?'; position = std::min(position + 4, text.length() - 1); break;
+        default: stringOut += escaped; break;
+        }
+    }
+
+    if(position >= text.length())
+        return false;
+    position++;
+    return true;
+}
+
+// Reads any JSON value. Strings and numbers inside objects are kept in 'fieldsOut' under their dotted key,
+// e.g. "args.detail", which is all a trace event needs
+static bool ReadValue(const std::string& text, size_t& position, const std::string& key,
+                      std::unordered_map<std::string, std::string>& fieldsOut)
+{
+    SkipWhitespace(text, position);
+    if(position >= text.length())
+        return false;
+
+    char first = text[position];
+    if(first == '{' || first == '[')
+    {
+        char last = (first == '{') ? '}' : ']';
+        position++;
+        SkipWhitespace(text, position);
+        if(position < text.length() && text[position] == last)
+        {
+            position++;
+            return true;
+        }
+
+        while(position < text.length())
+        {
+            std::string member = key;
+            if(first == '{')
+            {
+                std::string name;
+                SkipWhitespace(text, position);
+                if(!ReadString(text, position, name))
+                    return false;
+
+                SkipWhitespace(text, position);
+                if(position >= text.length() || text[position] != ':')
+                    return false;
+                position++;
+                member = key.empty() ? name : key + "." + name;
+            }
+
+            if(!ReadValue(text, position, member, fieldsOut))
+                return false;
+
+            SkipWhitespace(text, position);
+            if(position < text.length() && text[position] == ',')
+            {
+                position++;
+                continue;
+            }
+
+            if(position < text.length() && text[position] == last)
+            {
+                position++;
+                return true;
+            }
+            return false;
+        }
+        return false;
+    }
+
+    std::string value;
+    if(first == '"')
+    {
+        if(!ReadString(text, position, value))
+            return false;
+    }
+    else
+    {
+        size_t end = text.find_first_of(",}] \t\r\n", position);
+        if(end == std::string::npos)
+            end = text.length();
+        value = text.substr(position, end - position);
+        position = end;
+    }
+
+    fieldsOut[key] = value;
+    return true;
+}
+
+namespace Leo
+{
+    bool TimeTraceReport::AddTrace(const std::string& filepath)
+    {
+        std::ifstream file(filepath, std::ios::binary);
+        if(!file.is_open())
+            return false;
+
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        std::string text = buffer.str();
+
+        // Events are read one at a time, the rest of the file is of no interest
+        size_t position = text.find("\"traceEvents\"");
+        if(position == std::string::npos)
+            return false;
+
+        position = text.find('[', position);
+        if(position == std::string::npos)
+            return false;
+        position++;
+
+        // Durations are in microseconds. Nested events of the same header (rare) add up within the source
+        std::unordered_map<std::string, double> headers;
+        std::unordered_map<std::string, double> instantiations;
+        while(true)
+        {
+            SkipWhitespace(text, position);
+            if(position >= text.length())
+                return false;
+            if(text[position] == ']')
+                break;
+
+            std::unordered_map<std::string, std::string> fields;
+            if(!ReadValue(text, position, "", fields))
+                return false;
+
+            SkipWhitespace(text, position);
+            if(position < text.length() && text[position] == ',')
+                position++;
+
+            const std::string& name = fields["name"];
+            const std::string& detail = fields["args.detail"];
+            if(fields["ph"] != "X" || detail.empty())
+                continue;
+
+            double seconds = std::strtod(fields["dur"].c_str(), nullptr) / 1000000.0;
+            if(name == "Source")
+                headers[detail] += seconds;
+            else if(name == "InstantiateClass" || name == "InstantiateFunction")
+                instantiations[detail] += seconds;
+        }
+
+        for(const auto& [header, seconds] : headers)
+        {
+            mHeaders[header].seconds += seconds;
+            mHeaders[header].sources++;
+        }
+
+        for(const auto& [instantiation, seconds] : instantiations)
+        {
+            mInstantiations[instantiation].seconds += seconds;
+            mInstantiations[instantiation].sources++;
+        }
+
+        mTraceCount++;
+        return true;
+    }
+
+    size_t TimeTraceReport::GetTraceCount() const
+    {
+        return mTraceCount;
+    }
+
+    void TimeTraceReport::Display(size_t count) const
+    {
+        std::cout << "Time trace of " << mTraceCount << " source(s)\n";
+
+        auto display = [count](const std::string& title, const std::vector<std::pair<std::string, Cost>>& costs) {
+            std::cout << title << ":\n";
+            for(size_t i = 0; i < costs.size() && i < count; i++)
+            {
+                std::cout << "    " << std::fixed << std::setprecision(3) << std::setw(9) << costs[i].second.seconds << "s"
+                          << "  in " << std::setw(5) << costs[i].second.sources << " source(s)  " << costs[i].first << "\n";
+            }
+        };
+
+        display("Headers by total parse time", GetSorted(mHeaders));
+        display("Template instantiations by total time", GetSorted(mInstantiations));
+    }
+
+    bool TimeTraceReport::Save(std::string filepath) const
+    {
+        std::ofstream file(filepath, std::ios::trunc);
+        if(!file.is_open())
+            return false;
+
+        auto write = [&file](const std::vector<std::pair<std::string, Cost>>& costs) {
+            for(size_t i = 0; i < costs.size(); i++)
+            {
+                file << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << Utils::EscapeJson(costs[i].first) << "\", \"seconds\": "
+                     << std::fixed << std::setprecision(6) << costs[i].second.seconds << ", \"sources\": " << costs[i].second.sources << "}";
+            }
+            file << "\n  ]";
+        };
+
+        file << "{\n  \"sources\": " << mTraceCount << ",\n  \"headers\": [";
+        write(GetSorted(mHeaders));
+        file << ",\n  \"instantiations\": [";
+        write(GetSorted(mInstantiations));
+        file << "\n}\n";
+        return static_cast<bool>(file);
+    }
+
+    std::vector<std::pair<std::string, TimeTraceReport::Cost>> TimeTraceReport::GetSorted(const std::unordered_map<std::string, Cost>& costs)
+    {
+        std::vector<std::pair<std::string, Cost>> sorted(costs.begin(), costs.end());
+        std::sort(sorted.begin(), sorted.end(), [](const std::pair<std::string, Cost>& a, const std::pair<std::string, Cost>& b) {
+            return a.second.seconds > b.second.seconds;
+        });
+        return sorted;
+    }
+}
@@ -0,0 +1,236 @@
+#include "ToolchainProbe.hpp"
+
+#include <sstream>
+
+static const uint32_t toolchainProbeMagic = 0x544f454c; // "LEOT"
+static const uint32_t toolchainProbeVersion = 1;
+
+static std::string NormalizeDirectory(const std::string& directory)
+{
+    std::string result = std::filesystem::path(Utils::NormalizePath(directory)).lexically_normal().generic_string();
+    while(result.size() > 1 && result.back() == '/')
+        result.pop_back();
+    return result;
+}
+
+namespace Leo
+{
+    bool ToolchainProbe::Probe(const std::string& compilerPath, const std::string& filepath)
+    {
+        std::string program = Utils::FindProgram(compilerPath);
+        if(program.empty())
+        {
+            std::cout << "WARNING: Toolchain: Can't find the compiler " << compilerPath << "\n";
+            return false;
+        }
+
+        // Distributions install compilers as links to versioned files, an update changes the file
+        std::error_code error;
+        std::filesystem::path canonical = std::filesystem::canonical(program, error);
+        std::string compilerFile = error ? program : canonical.generic_string();
+        Utils::FileStamp compilerStamp = Utils::GetFileStamp(compilerFile);
+
+        if(Load(filepath) && mCompilerFile == compilerFile && mCompilerStamp == compilerStamp)
+            return true;
+
+        mCompilerFile = compilerFile;
+        mCompilerStamp = compilerStamp;
+        mVersion.clear();
+        mMachine.clear();
+        mSystemIncludeDirs.clear();
+
+        std::string output;
+        std::string outputFile = filepath + ".output";
+        if(!ReadOutput(compilerPath, { "--version" }, outputFile, output))
+            return false;
+        mVersion = output.substr(0, output.find_first_of("\r\n"));
+
+        if(!ReadOutput(compilerPath, { "-dumpmachine" }, outputFile, output))
+            return false;
+        mMachine = output.substr(0, output.find_first_of("\r\n"));
+
+        // Preprocessing an empty file lists the search directories between these two lines
+        std::string emptySource = filepath + ".empty";
+        std::ofstream(emptySource, std::ios::trunc).close();
+        bool listed = ReadOutput(compilerPath, { "-x", "c++", "-E", "-v", emptySource, "-o", outputFile + ".i" }, outputFile, output);
+        std::filesystem::remove(emptySource, error);
+        std::filesystem::remove(outputFile + ".i", error);
+        if(!listed)
+            return false;
+
+        std::istringstream lines(output);
+        std::string line;
+        bool inList = false;
+        while(std::getline(lines, line))
+        {
+            if(!line.empty() && line.back() == '\r')
+                line.pop_back();
+
+            if(line.find("#include <...> search starts here:") == 0)
+                inList = true;
+            else if(line.find("End of search list.") == 0)
+                inList = false;
+            else if(inList && !line.empty() && line[0] == ' ')
+            {
+                // Clang marks macOS framework directories
+                std::string directory = line.substr(1);
+                size_t framework = directory.find(" (framework directory)");
+                if(framework != std::string::npos)
+                    directory.erase(framework);
+                mSystemIncludeDirs.push_back(NormalizeDirectory(directory));
+            }
+        }
+
+        if(!Save(filepath))
+            std::cout << "WARNING: Toolchain: Can't save " << filepath << "\n";
+        return true;
+    }
+
+    const std::string& ToolchainProbe::GetCompilerFile() const
+    {
+        return mCompilerFile;
+    }
+
+    const std::string& ToolchainProbe::GetVersion() const
+    {
+        return mVersion;
+    }
+
+    const std::string& ToolchainProbe::GetMachine() const
+    {
+        return mMachine;
+    }
+
+    const std::vector<std::string>& ToolchainProbe::GetSystemIncludeDirs() const
+    {
+        return mSystemIncludeDirs;
+    }
+
+    bool ToolchainProbe::IsClang() const
+    {
+        return mVersion.find("clang") != std::string::npos;
+    }
+
+    uint64_t ToolchainProbe::GetIdentity() const
+    {
+        uint64_t identity = Utils::HashString(mVersion);
+        identity = Utils::HashString(mMachine, Utils::HashValue(mMachine.size(), identity));
+        for(const std::string& directory : mSystemIncludeDirs)
+            identity = Utils::HashString(directory, Utils::HashValue(directory.size(), identity));
+        return identity;
+    }
+
+    bool ToolchainProbe::IsSystemHeader(const std::string& path) const
+    {
+        std::string normalized = NormalizeDirectory(path);
+        for(const std::string& directory : mSystemIncludeDirs)
+        {
+            if(normalized.size() > directory.size() && normalized[directory.size()] == '/'
+               && normalized.compare(0, directory.size(), directory) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    bool ToolchainProbe::TargetsWindows() const
+    {
+        if(mMachine.empty())
+        {
+        #ifdef _WIN32
+            return true;
+        #else
+            return false;
+        #endif
+        }
+
+        return mMachine.find("mingw") != std::string::npos || mMachine.find("windows") != std::string::npos
+               || mMachine.find("cygwin") != std::string::npos;
+    }
+
+    std::string ToolchainProbe::GetArchiverPath() const
+    {
+        if(!mMachine.empty() && !Utils::FindProgram(mMachine + "-ar").empty())
+            return mMachine + "-ar";
+        return "ar";
+    }
+
+    bool ToolchainProbe::Load(const std::string& filepath)
+    {
+        std::ifstream file(filepath, std::ios::binary);
+        if(!file.is_open())
+            return false;
+
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        uint32_t directoryCount = 0;
+        Utils::ReadBinary(file, magic);
+        Utils::ReadBinary(file, version);
+        if(magic != toolchainProbeMagic || version != toolchainProbeVersion)
+            return false;
+
+        Utils::ReadBinary(file, mCompilerFile);
+        Utils::ReadBinary(file, mCompilerStamp.modifiedTime);
+        Utils::ReadBinary(file, mCompilerStamp.size);
+        mCompilerStamp.exists = true;
+        Utils::ReadBinary(file, mVersion);
+        Utils::ReadBinary(file, mMachine);
+        Utils::ReadBinary(file, directoryCount);
+        mSystemIncludeDirs.clear();
+        for(uint32_t i = 0; i < directoryCount && file; i++)
+        {
+            std::string directory;
+            Utils::ReadBinary(file, directory);
+            mSystemIncludeDirs.push_back(directory);
+        }
+
+        return static_cast<bool>(file);
+    }
+
+    bool ToolchainProbe::Save(const std::string& filepath)
+    {
+        std::string tmpPath = filepath + ".tmp";
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!file.is_open())
+            return false;
+
+        Utils::WriteBinary(file, toolchainProbeMagic);
+        Utils::WriteBinary(file, toolchainProbeVersion);
+        Utils::WriteBinary(file, mCompilerFile);
+        Utils::WriteBinary(file, mCompilerStamp.modifiedTime);
+        Utils::WriteBinary(file, mCompilerStamp.size);
+        Utils::WriteBinary(file, mVersion);
+        Utils::WriteBinary(file, mMachine);
+        Utils::WriteBinary(file, static_cast<uint32_t>(mSystemIncludeDirs.size()));
+        for(const std::string& directory : mSystemIncludeDirs)
+            Utils::WriteBinary(file, directory);
+        file.close();
+
+        std::error_code error;
+        std::filesystem::rename(tmpPath, filepath, error);
+        return !error;
+    }
+
+    bool ToolchainProbe::ReadOutput(const std::string& compilerPath, const std::vector<std::string>& arguments,
+                                    const std::string& outputFile, std::string& outputOut)
+    {
+        int exitCode = Utils::StartProcessAndWait(compilerPath, arguments, nullptr, "", outputFile);
+
+        std::ifstream file(outputFile, std::ios::binary);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        outputOut = buffer.str();
+        file.close();
+
+        std::error_code error;
+        std::filesystem::remove(outputFile, error);
+        if(exitCode != 0)
+        {
+            std::string command = compilerPath;
+            for(const std::string& argument : arguments)
+                command += " " + argument;
+            std::cout << "WARNING: Toolchain: " << command << " failed (exit code " << exitCode << ")\n";
+            return false;
+        }
+        return true;
+    }
+}
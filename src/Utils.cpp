@@ -1,19 +1,52 @@
 #include "Utils.hpp"
 #include <string.h>
+#include <mutex>
+#include <cerrno>
+#include <cstdlib>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <unordered_set>
 #ifdef _WIN32
 #include <windows.h>
 #else
 #include <unistd.h>
 #include <sys/wait.h>
+#include <signal.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <fcntl.h>
 #endif
 
 namespace Utils
 {
+    Counters& GetCounters()
+    {
+        static Counters counters;
+        return counters;
+    }
+
+    bool WriteCounters(std::string filepath)
+    {
+        std::ofstream file(filepath);
+        if(!file.is_open())
+            return false;
+
+        file << "{\"process_spawns\": " << GetCounters().processSpawns
+             << ", \"stat_calls\": " << GetCounters().statCalls << "}\n";
+        return true;
+    }
+
 #ifdef _WIN32
 
-    void StartProcessAndWait(std::string program, const std::vector<std::string>& args)
+    // Handles of the running children, for TerminateRunningProcesses()
+    static std::mutex runningProcessesMutex;
+    static std::unordered_set<HANDLE> runningProcesses;
+
+    int StartProcessAndWait(std::string program, const std::vector<std::string>& args, ProcessStats* stats,
+                            const std::string& workingDir, const std::string& outputFile)
     {
         STARTUPINFO si;
         PROCESS_INFORMATION pi;
@@ -40,27 +73,91 @@ namespace Utils
             if (!SearchPath(NULL, program.c_str(), ".exe", MAX_PATH, programPath, NULL))
             {
                 std::cout << "Error " << GetLastError() << ": Failed to find " << program << " in PATH\n";
-                return;
+                return -1;
             }
 
             program = programPath;
         }
 
-        if(!CreateProcessA(program.c_str(), argv, NULL, NULL, FALSE, 0, NULL, NULL, &si, &pi))
+        HANDLE output = INVALID_HANDLE_VALUE;
+        if(!outputFile.empty())
+        {
+            SECURITY_ATTRIBUTES attributes = { sizeof(attributes), NULL, TRUE };
+            output = CreateFileA(outputFile.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &attributes, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+            if(output == INVALID_HANDLE_VALUE)
+            {
+                std::cout << "Failed to create " << outputFile << "\n";
+                return -1;
+            }
+
+            si.dwFlags |= STARTF_USESTDHANDLES;
+            si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+            si.hStdOutput = output;
+            si.hStdError = output;
+        }
+
+        auto startTime = std::chrono::steady_clock::now();
+        GetCounters().processSpawns++;
+        BOOL created = CreateProcessA(program.c_str(), argv, NULL, NULL, output != INVALID_HANDLE_VALUE, 0, NULL,
+                                      workingDir.empty() ? NULL : workingDir.c_str(), &si, &pi);
+        if(output != INVALID_HANDLE_VALUE)
+            CloseHandle(output);
+
+        if(!created)
         {
             std::cout << "CreateProcess failed: " << GetLastError() << "\n";
-            return;
+            return -1;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(runningProcessesMutex);
+            runningProcesses.insert(pi.hProcess);
         }
 
         WaitForSingleObject( pi.hProcess, INFINITE );
 
+        {
+            std::lock_guard<std::mutex> lock(runningProcessesMutex);
+            runningProcesses.erase(pi.hProcess);
+        }
+
+        if(stats != nullptr)
+        {
+            FILETIME creationTime, exitTime, kernelTime, userTime;
+            stats->wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+            if(GetProcessTimes(pi.hProcess, &creationTime, &exitTime, &kernelTime, &userTime))
+            {
+                // FILETIME counts 100 nanosecond intervals
+                uint64_t kernel = (static_cast<uint64_t>(kernelTime.dwHighDateTime) << 32) | kernelTime.dwLowDateTime;
+                uint64_t user = (static_cast<uint64_t>(userTime.dwHighDateTime) << 32) | userTime.dwLowDateTime;
+                stats->cpuSeconds = (kernel + user) / 1.0e7;
+            }
+        }
+
+        DWORD exitCode = 0;
+        if(!GetExitCodeProcess(pi.hProcess, &exitCode))
+            exitCode = static_cast<DWORD>(-1);
+
         CloseHandle( pi.hProcess );
         CloseHandle( pi.hThread );
+        return static_cast<int>(exitCode);
+    }
+
+    void TerminateRunningProcesses()
+    {
+        std::lock_guard<std::mutex> lock(runningProcessesMutex);
+        for(HANDLE process : runningProcesses)
+            TerminateProcess(process, 1);
     }
 
 #else
     
-    void StartProcessAndWait(std::string program, const std::vector<std::string>& args)
+    // Children that haven't been reaped yet, for TerminateRunningProcesses()
+    static std::mutex runningProcessesMutex;
+    static std::unordered_set<pid_t> runningProcesses;
+
+    int StartProcessAndWait(std::string program, const std::vector<std::string>& args, ProcessStats* stats,
+                            const std::string& workingDir, const std::string& outputFile)
     {
         unsigned int size = args.size() + 2;
         char* argv[size];
@@ -70,28 +167,258 @@ namespace Utils
             argv[i+1] = const_cast<char*>(args[i].c_str());
         argv[args.size() + 1] = nullptr;
 
+        // Prepared up front, the child can't allocate safely while other threads run
+        std::string execError = "Failed to execute \"" + program + "\"\n";
+
+        int output = -1;
+        if(!outputFile.empty())
+        {
+            output = open(outputFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if(output == -1)
+            {
+                std::cout << "Failed to create " << outputFile << "\n";
+                return -1;
+            }
+        }
+
         pid_t pid;
-        int status;
+        int status = 0;
+        struct rusage usage;
+        auto startTime = std::chrono::steady_clock::now();
+        GetCounters().processSpawns++;
+
+        // Registered while the lock is held, so a concurrent TerminateRunningProcesses() can't miss it
+        std::unique_lock<std::mutex> lock(runningProcessesMutex);
         pid = fork();
 
         switch(pid)
         {
         case -1:
+            lock.unlock();
+            if(output != -1)
+                close(output);
             std::cout << "Failed to fork process\n";
-            break;
+            return -1;
 
         case 0:
+        {
+            if(!workingDir.empty() && chdir(workingDir.c_str()) != 0)
+                _exit(127);
+
+            if(output != -1)
+            {
+                dup2(output, STDOUT_FILENO);
+                dup2(output, STDERR_FILENO);
+            }
+
             execvp(program.c_str(), argv);
-            std::cout << "Failed to execute \"" << program << "\"\n";
-            exit(EXIT_FAILURE);
-            break;
+
+            // Other threads may hold the stream and heap locks, only async-signal-safe calls from here on
+            ssize_t written = write(STDOUT_FILENO, execError.c_str(), execError.length());
+            (void)written;
+            _exit(127);
+        }
 
         default:
-            wait(&status);
+            runningProcesses.insert(pid);
+            lock.unlock();
+            if(output != -1)
+                close(output);
+
+            // Leave the child a zombie until it's unregistered, its pid can't be reused before that
+            siginfo_t info;
+            while(waitid(P_PID, pid, &info, WEXITED | WNOWAIT) == -1 && errno == EINTR) {}
+
+            lock.lock();
+            runningProcesses.erase(pid);
+            lock.unlock();
+
+            wait4(pid, &status, 0, &usage);
+            if(stats != nullptr)
+            {
+                stats->wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+                stats->cpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1.0e6
+                                  + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1.0e6;
+                // ru_maxrss is reported in kilobytes on Linux
+                stats->peakMemoryKB = static_cast<uint64_t>(usage.ru_maxrss);
+            }
             break;
         }
+
+        if(WIFEXITED(status))
+            return WEXITSTATUS(status);
+        if(WIFSIGNALED(status))
+            return 128 + WTERMSIG(status);
+        return -1;
+    }
+
+    void TerminateRunningProcesses()
+    {
+        std::lock_guard<std::mutex> lock(runningProcessesMutex);
+        for(pid_t pid : runningProcesses)
+            kill(pid, SIGTERM);
     }
 
 #endif
 
+    FileStamp GetFileStamp(const std::string& path)
+    {
+        FileStamp stamp;
+        GetCounters().statCalls++;
+
+    #if defined(STATX_MTIME)
+        // Only ask for the fields we compare, network file systems answer that faster
+        struct statx info;
+        if(statx(AT_FDCWD, path.c_str(), 0, STATX_MTIME | STATX_SIZE, &info) == 0)
+        {
+            stamp.exists = true;
+            stamp.size = info.stx_size;
+            stamp.modifiedTime = static_cast<int64_t>(info.stx_mtime.tv_sec) * 1000000000 + info.stx_mtime.tv_nsec;
+        }
+    #else
+        std::error_code error;
+        std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+        if(!error)
+        {
+            stamp.exists = true;
+            stamp.size = std::filesystem::file_size(path, error);
+            stamp.modifiedTime = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+        }
+    #endif
+
+        return stamp;
+    }
+
+    void GetFileStamps(const std::vector<std::string>& paths, std::vector<FileStamp>& stampsOut)
+    {
+        stampsOut.resize(paths.size());
+
+        // Starting threads costs more than a few hundred stats
+        const size_t filesPerThread = 1024;
+        size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                              (paths.size() + filesPerThread - 1) / filesPerThread);
+
+        auto statRange = [&](size_t begin, size_t end) {
+        #if defined(STATX_MTIME)
+            // Sorted lists keep files of a directory together. Resolving names relative to an
+            // open directory skips walking the same leading path components for every file
+            int dirFd = -1;
+            std::string dir;
+            for(size_t i = begin; i < end; i++)
+            {
+                std::string::size_type pos = paths[i].find_last_of('/');
+                if(pos == std::string::npos || pos == 0)
+                {
+                    stampsOut[i] = GetFileStamp(paths[i]);
+                    continue;
+                }
+
+                if(dirFd == -1 || paths[i].compare(0, pos, dir) != 0 || dir.length() != pos)
+                {
+                    if(dirFd != -1) close(dirFd);
+                    dir = paths[i].substr(0, pos);
+                    dirFd = open(dir.c_str(), O_PATH | O_DIRECTORY);
+                }
+
+                struct statx info;
+                FileStamp& stamp = stampsOut[i];
+                stamp = FileStamp();
+                GetCounters().statCalls++;
+                if(dirFd != -1 && statx(dirFd, paths[i].c_str() + pos + 1, 0, STATX_MTIME | STATX_SIZE, &info) == 0)
+                {
+                    stamp.exists = true;
+                    stamp.size = info.stx_size;
+                    stamp.modifiedTime = static_cast<int64_t>(info.stx_mtime.tv_sec) * 1000000000 + info.stx_mtime.tv_nsec;
+                }
+            }
+
+            if(dirFd != -1) close(dirFd);
+        #else
+            for(size_t i = begin; i < end; i++)
+                stampsOut[i] = GetFileStamp(paths[i]);
+        #endif
+        };
+
+        if(threadCount <= 1)
+        {
+            statRange(0, paths.size());
+            return;
+        }
+
+        std::vector<std::thread> threads;
+        size_t chunk = (paths.size() + threadCount - 1) / threadCount;
+        for(size_t begin = 0; begin < paths.size(); begin += chunk)
+            threads.emplace_back(statRange, begin, std::min(begin + chunk, paths.size()));
+
+        for(std::thread& thread : threads)
+            thread.join();
+    }
+
+    std::string FindProgram(const std::string& program)
+    {
+        if(program.find_first_of("/\\") != std::string::npos)
+            return PathExists(program) ? program : "";
+
+    #ifdef _WIN32
+        const char separator = ';';
+        const std::vector<std::string> extensions = { "", ".exe" };
+    #else
+        const char separator = ':';
+        const std::vector<std::string> extensions = { "" };
+    #endif
+
+        const char* path = std::getenv("PATH");
+        std::stringstream directories((path != nullptr) ? path : "");
+        std::string directory;
+        while(std::getline(directories, directory, separator))
+        {
+            for(const std::string& extension : extensions)
+            {
+                std::string candidate = (directory.empty() ? std::string(".") : directory) + "/" + program + extension;
+                std::error_code error;
+                if(std::filesystem::is_regular_file(candidate, error))
+                    return candidate;
+            }
+        }
+        return "";
+    }
+
+    std::string GetGitHead(std::string rootDir)
+    {
+        std::string gitDir = rootDir + "/.git";
+        std::ifstream headFile(gitDir + "/HEAD");
+        if(!headFile.is_open())
+            return "";
+
+        std::string head;
+        std::getline(headFile, head);
+        headFile.close();
+
+        // Detached HEAD holds the commit hash directly
+        const std::string refPrefix = "ref: ";
+        if(head.compare(0, refPrefix.length(), refPrefix) != 0)
+            return head;
+
+        std::string ref = head.substr(refPrefix.length());
+        std::ifstream refFile(gitDir + "/" + ref);
+        if(refFile.is_open())
+        {
+            std::string hash;
+            std::getline(refFile, hash);
+            return hash;
+        }
+
+        // Fall back to packed refs, each line is "<hash> <ref>"
+        std::ifstream packedRefs(gitDir + "/packed-refs");
+        std::string line;
+        while(std::getline(packedRefs, line))
+        {
+            std::string::size_type pos = line.find(' ');
+            if(pos != std::string::npos && line.substr(pos + 1) == ref)
+                return line.substr(0, pos);
+        }
+
+        return "";
+    }
+
 }
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include "Workspace.hpp"
+#include "JobPool.hpp"
+#include "ext/tinyxml2/tinyxml2.h"
+#include "Utils.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <thread>
+using namespace tinyxml2;
+
+namespace Leo
+{
+    Workspace::Workspace(const BuildSystem& settings, std::string buildDir, size_t jobCount)
+        : mSettings(settings), mBuildDir(buildDir), mJobCount(jobCount)
+    {
+    }
+
+    bool Workspace::IsWorkspaceFile(const std::string& filepath)
+    {
+        XMLDocument doc;
+        doc.LoadFile(filepath.c_str());
+        return !doc.Error() && doc.FirstChildElement("Workspace") != nullptr;
+    }
+
+    bool Workspace::AddFile(std::string filepath)
+    {
+        if(!IsWorkspaceFile(filepath))
+        {
+            if(std::find(mProjectFiles.begin(), mProjectFiles.end(), filepath) == mProjectFiles.end())
+                mProjectFiles.push_back(filepath);
+            return true;
+        }
+
+        std::string absolutePath = std::filesystem::path(Utils::GetAbsolutePath(filepath)).lexically_normal().generic_string();
+        if(std::find(mExpandingFiles.begin(), mExpandingFiles.end(), absolutePath) != mExpandingFiles.end())
+        {
+            std::cout << "ERROR: Workspace: " << filepath << " includes itself\n";
+            return false;
+        }
+
+        mExpandingFiles.push_back(absolutePath);
+        bool success = AddWorkspaceProjects(filepath);
+        mExpandingFiles.pop_back();
+        return success;
+    }
+
+    bool Workspace::AddWorkspaceProjects(const std::string& filepath)
+    {
+        XMLDocument doc;
+        doc.LoadFile(filepath.c_str());
+        std::filesystem::path workspaceDir = std::filesystem::path(Utils::NormalizePath(filepath)).parent_path();
+
+        XMLElement* workspace = doc.FirstChildElement("Workspace");
+        for(XMLElement* element = workspace->FirstChildElement("Project"); element != nullptr;
+            element = element->NextSiblingElement("Project"))
+        {
+            if(element->GetText() == nullptr)
+                continue;
+
+            std::string projectFile = (workspaceDir / element->GetText()).lexically_normal().generic_string();
+            if(!Utils::PathExists(projectFile))
+            {
+                std::cout << "ERROR: Workspace: Project file of " << filepath << " doesn't exist: " << projectFile << "\n";
+                return false;
+            }
+
+            if(!AddFile(projectFile))
+                return false;
+        }
+        return true;
+    }
+
+    bool Workspace::Build()
+    {
+        std::vector<Project> projects;
+        if(!LoadProjects(projects))
+            return false;
+
+        // A project's link may wait for another project, the waiting happens outside the pool's workers
+        JobPool jobPool(mJobCount);
+        std::vector<std::promise<bool>> built(projects.size());
+        std::vector<std::shared_future<bool>> results;
+        for(std::promise<bool>& promise : built)
+            results.push_back(promise.get_future().share());
+
+        for(Project& project : projects)
+        {
+            for(size_t dependency : project.dependencies)
+                project.buildSystem->AddProjectDependency(projects[dependency].buildSystem.get(), results[dependency]);
+        }
+
+        std::vector<std::thread> builds;
+        for(size_t i = 0; i < projects.size(); i++)
+        {
+            if(projects[i].upToDate)
+            {
+                built[i].set_value(true);
+                continue;
+            }
+
+            builds.emplace_back([&, i]() { built[i].set_value(projects[i].buildSystem->StartBuild(&jobPool)); });
+        }
+
+        for(std::thread& build : builds)
+            build.join();
+
+        bool success = true;
+        for(size_t i = 0; i < projects.size(); i++)
+        {
+            bool result = results[i].get();
+            std::cout << "Project " << projects[i].buildSystem->GetProjectName() << ": "
+                      << (projects[i].upToDate ? "up to date" : (result ? "succeeded" : "failed")) << "\n";
+            success = success && result;
+        }
+
+        return success;
+    }
+
+    bool Workspace::LoadProjects(std::vector<Project>& projectsOut)
+    {
+        if(mProjectFiles.empty())
+        {
+            std::cout << "ERROR: Workspace: No project files to read\n";
+            return false;
+        }
+
+        // Build directories are named after the project files
+        std::vector<std::string> stems;
+        for(const std::string& file : mProjectFiles)
+        {
+            std::string stem = std::filesystem::path(file).stem().string();
+            if(std::find(stems.begin(), stems.end(), stem) != stems.end())
+            {
+                std::cout << "ERROR: Workspace: More than one project file is named '" << stem << "'\n";
+                return false;
+            }
+            stems.push_back(stem);
+
+            Project project;
+            project.file = file;
+            project.buildSystem = std::make_unique<BuildSystem>(mSettings);
+            project.buildSystem->SetBuildDir((mBuildDir.empty() ? std::string(".") : mBuildDir) + "/" + stem);
+            projectsOut.push_back(std::move(project));
+        }
+
+        // Reading is independent per project, large workspaces spend noticeable time parsing
+        std::vector<char> loaded(projectsOut.size(), 0);
+        std::vector<std::thread> loaders;
+        for(size_t i = 0; i < projectsOut.size(); i++)
+        {
+            loaders.emplace_back([&, i]() {
+                Project& project = projectsOut[i];
+                project.upToDate = project.buildSystem->IsUpToDate(project.file);
+                loaded[i] = project.buildSystem->ReadProjectFile(project.file);
+            });
+        }
+
+        for(std::thread& loader : loaders)
+            loader.join();
+
+        for(size_t i = 0; i < projectsOut.size(); i++)
+        {
+            if(!loaded[i])
+            {
+                std::cout << "ERROR: Workspace: Failed to read project file: " << projectsOut[i].file << "\n";
+                return false;
+            }
+        }
+
+        for(Project& project : projectsOut)
+        {
+            std::string name = project.buildSystem->GetProjectName();
+            for(const std::string& dependencyName : project.buildSystem->GetProjectDependencies())
+            {
+                auto dependency = std::find_if(projectsOut.begin(), projectsOut.end(), [&dependencyName](const Project& other) {
+                    return other.buildSystem->GetProjectName() == dependencyName;
+                });
+
+                if(dependency == projectsOut.end())
+                {
+                    std::cout << "ERROR: Workspace: Project '" << name << "' depends on '" << dependencyName << "', which is not part of the workspace\n";
+                    return false;
+                }
+                project.dependencies.push_back(static_cast<size_t>(dependency - projectsOut.begin()));
+            }
+
+            if(std::count_if(projectsOut.begin(), projectsOut.end(), [&name](const Project& other) { return other.buildSystem->GetProjectName() == name; }) > 1)
+            {
+                std::cout << "ERROR: Workspace: More than one project is named '" << name << "'\n";
+                return false;
+            }
+        }
+
+        // A link waits for the builds of the projects it depends on, a cycle would never finish
+        std::vector<int> visitState(projectsOut.size(), 0);
+        std::function<bool(size_t)> isAcyclic = [&](size_t index) {
+            if(visitState[index] != 0)
+                return visitState[index] == 2;
+
+            visitState[index] = 1;
+            for(size_t dependency : projectsOut[index].dependencies)
+            {
+                if(!isAcyclic(dependency))
+                    return false;
+            }
+
+            // Rebuilt libraries have to be linked into their dependents again
+            for(size_t dependency : projectsOut[index].dependencies)
+                projectsOut[index].upToDate = projectsOut[index].upToDate && projectsOut[dependency].upToDate;
+
+            visitState[index] = 2;
+            return true;
+        };
+
+        for(size_t i = 0; i < projectsOut.size(); i++)
+        {
+            if(!isAcyclic(i))
+            {
+                std::cout << "ERROR: Workspace: Project '" << projectsOut[i].buildSystem->GetProjectName() << "' is part of a dependency cycle\n";
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,80 @@
+// Checks of the token fingerprint, which decides whether an edit rebuilds the dependents of a file
+// Prints every failing check and returns non-zero if there was one
+
+#include "Fingerprint.hpp"
+
+#include <iostream>
+
+static int failures = 0;
+
+static void Check(bool sameExpected, const std::string& a, const std::string& b, bool keepLines = true)
+{
+    bool same = Leo::GetTokenFingerprint(a, keepLines) == Leo::GetTokenFingerprint(b, keepLines);
+    if(same == sameExpected)
+        return;
+
+    failures++;
+    std::cout << "FAILED: expected " << (sameExpected ? "equal" : "different") << " fingerprints"
+              << (keepLines ? "" : " (ignoring lines)") << "\n    " << a << "\n    " << b << "\n";
+}
+
+static void Equal(const std::string& a, const std::string& b, bool keepLines = true)
+{
+    Check(true, a, b, keepLines);
+}
+
+static void Different(const std::string& a, const std::string& b, bool keepLines = true)
+{
+    Check(false, a, b, keepLines);
+}
+
+int main()
+{
+    // Whitespace
+    Equal("int x = 1;\n", "int  x=1 ;\n");
+    Equal("int x = 1;\n", "\tint x = 1;   \n");
+    Different("int x = 1;\n", "intx = 1;\n");
+    Different("a + +b;\n", "a ++b;\n");
+    Different("int x;\nint y;\n", "int x; int y;\n");
+    Equal("int x;\nint y;\n", "int x; int y;\n", false);
+
+    // Macro definitions, the space after the name makes a function-like macro object-like
+    Different("#define X(a) a\n", "#define X (a) a\n");
+    Different("#define X(a) a\n", "#define X/**/(a) a\n");
+    Equal("#define X(a) a\n", "#define X(a)  a\n");
+    Equal("#define X (a) a\n", "#define X  (a) a\n");
+    Equal("#define X 1\n", "# define X /* one */ 1\n");
+    Equal("X (a);\n", "X(a);\n");
+    Different("#define X 1\n", "#define X\n1\n", false);
+
+    // Comments
+    Equal("int x; // one\n", "int x; // two\n");
+    Equal("int x; /* one */ int y;\n", "int x; /* two */ int y;\n");
+    Equal("int/**/x;\n", "int x;\n");
+    Different("int/**/x;\n", "intx;\n");
+    Different("int x; /* one\n*/ int y;\n", "int x; /* one */ int y;\n");
+    Equal("int x; /* one\n*/ int y;\n", "int x; /* one */ int y;\n", false);
+    Different("int x = a // b\n/ c;\n", "int x = a / c;\n");
+    Equal("const char* s = \"// not a comment\";\n", "const char* s = \"// not a comment\";  // comment\n");
+    Different("const char* s = \"/* a */\";\n", "const char* s = \"/* b */\";\n");
+
+    // Digit separators
+    Equal("int x = 1'000'000; // it's\n", "int x = 1'000'000; // its\n");
+    Different("int x = 1'000'000;\n", "int x = 1'000'001;\n");
+    Different("int x = 1'000; char c = 'a';\n", "int x = 1'000; char c = 'b';\n");
+
+    // Literals
+    Different("const char* s = \"a b\";\n", "const char* s = \"a  b\";\n");
+    Different("char c = ' ';\n", "char c = '  ';\n");
+    Different("auto s = u8\"x\";\n", "auto s = u8 \"x\";\n");
+
+    // Raw strings keep everything between their delimiters, comments and newlines included
+    Different("auto s = R\"(a // b)\";\n", "auto s = R\"(a // c)\";\n");
+    Different("auto s = R\"(a\n  b)\";\n", "auto s = R\"(a\nb)\";\n", false);
+    Different("auto s = R\"x(a)\" b)x\";\n", "auto s = R\"x(a)\"  b)x\";\n");
+    Equal("auto s = R\"(a)\"; // one\n", "auto s = R\"(a)\";   // two\n");
+
+    if(failures == 0)
+        std::cout << "All fingerprint checks passed\n";
+    return (failures == 0) ? 0 : 1;
+}